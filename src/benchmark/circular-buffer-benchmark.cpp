@@ -0,0 +1,543 @@
+/*
+ * File:   circular-buffer-benchmark.cpp
+ */
+#include "../binaryLogger.h"
+#include "../circularBuffer.h"
+#ifdef DO_PERF_COUNTERS
+#include "../perfCounters.h"
+#endif
+#include "../slabQueue.h"
+#include "../timingWheel.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+////////////////////////////////////////////////////////////////////////////////
+// Benchmarks of the circular buffer
+
+// The data type stored in the circular buffer
+using cbtype = uint64_t;
+
+// Alias for the circular buffer templated type used in the benchmarks
+using cb_t = circular_buffer::cb<cbtype>;
+using cbAddMode = circular_buffer::cbBase::cbAddMode;
+// Size of the circular buffer used in the benchmarks
+static constexpr unsigned int CBSIZE {1'024};
+
+// Number of items produced by every producer thread
+static constexpr cbtype ITEMS_PER_PRODUCER {100'000};
+
+// Number of producer threads: up to twice the number of cores
+static
+std::vector<unsigned int>
+producerCounts() noexcept(false)
+{
+  const unsigned int maxProducers {2 * std::max(1u, std::thread::hardware_concurrency())};
+  std::vector<unsigned int> counts {};
+
+  for (unsigned int n {1}; n < maxProducers; n *= 2)
+  {
+    counts.push_back(n);
+  }
+  counts.push_back(maxProducers);
+  return counts;
+}  // producerCounts
+
+// numProducers threads add ITEMS_PER_PRODUCER items each, one consumer thread
+// removes all of them.
+// Return the throughput of the adds in millions of items per second
+static
+double
+addBenchmark(const cbAddMode addMode, const unsigned int numProducers) noexcept(false)
+{
+  const cb_t aCircularBuffer(CBSIZE, addMode);
+  const cbtype numItems {numProducers * ITEMS_PER_PRODUCER};
+  std::atomic<bool> go {false};
+
+  std::thread consumer([&aCircularBuffer, &go, numItems] ()
+                       {
+                         while ( !go.load(std::memory_order_acquire) ) { std::this_thread::yield(); }
+                         for (cbtype removed {0}; removed < numItems; )
+                         {
+                           if ( circular_buffer::cbBase::cbStatus::REMOVED ==
+                                std::get<0>(aCircularBuffer.remove()) )
+                           {
+                             ++removed;
+                           }
+                           else
+                           {
+                             std::this_thread::yield();
+                           }
+                         }
+                       });
+
+  std::vector<std::thread> producers {};
+  for (unsigned int p {0}; p < numProducers; ++p)
+  {
+    producers.emplace_back([&aCircularBuffer, &go] ()
+                           {
+                             while ( !go.load(std::memory_order_acquire) ) { std::this_thread::yield(); }
+                             for (cbtype item {0}; item < ITEMS_PER_PRODUCER; )
+                             {
+                               if ( circular_buffer::cbBase::cbStatus::ADDED ==
+                                    std::get<0>(aCircularBuffer.add(item)) )
+                               {
+                                 ++item;
+                               }
+                               else
+                               {
+                                 std::this_thread::yield();
+                               }
+                             }
+                           });
+  }
+
+  const auto start {std::chrono::steady_clock::now()};
+  go.store(true, std::memory_order_release);
+  for (auto& p : producers)
+  {
+    p.join();
+  }
+  consumer.join();
+  const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - start};
+
+  return static_cast<double>(numItems) / elapsed.count() / 1e6;
+}  // addBenchmark
+
+static
+void
+flatCombiningBenchmark() noexcept(false)
+{
+  std::cout << "[" << __func__ << "] STARTING\n\n"
+            << "[" << __func__ << "] "
+            << "add() throughput (Mitems/s), buffer of " << CBSIZE
+            << " elements, " << ITEMS_PER_PRODUCER << " items per producer\n"
+            << "[" << __func__ << "] "
+            << std::setw(10) << "producers"
+            << std::setw(12) << "mutex"
+            << std::setw(18) << "flat-combining" << "\n";
+
+  for (auto numProducers : producerCounts())
+  {
+    const double mutexThroughput {addBenchmark(cbAddMode::MUTEX, numProducers)};
+    const double fcThroughput {addBenchmark(cbAddMode::FLAT_COMBINING, numProducers)};
+
+    std::cout << "[" << __func__ << "] "
+              << std::setw(10) << numProducers
+              << std::fixed << std::setprecision(2)
+              << std::setw(12) << mutexThroughput
+              << std::setw(18) << fcThroughput << "\n";
+  }
+
+  std::cout << "\n[" << __func__ << "] "
+            << "TERMINATED\n";
+}  // flatCombiningBenchmark
+
+#ifdef DO_PERF_COUNTERS
+// one producer and one consumer adding and removing ITEMS_PER_PRODUCER items in
+// tight loops: the counters of each thread are enabled once around its loop and
+// divided by its number of add()/remove() calls
+static
+void
+perfCountersRun(const cbAddMode addMode, const std::string& modeName) noexcept(false)
+{
+  const cb_t aCircularBuffer(CBSIZE, addMode);
+  std::atomic<bool> go {false};
+
+  std::thread consumer([&aCircularBuffer, &go, &modeName] ()
+                       {
+                         circular_buffer::perfCounters counters {};
+                         uint64_t numOps {0};
+
+                         while ( !go.load(std::memory_order_acquire) ) { std::this_thread::yield(); }
+                         counters.start();
+                         for (cbtype removed {0}; removed < ITEMS_PER_PRODUCER; ++numOps)
+                         {
+                           if ( circular_buffer::cbBase::cbStatus::REMOVED ==
+                                std::get<0>(aCircularBuffer.remove()) )
+                           {
+                             ++removed;
+                           }
+                         }
+                         counters.stop();
+                         counters.print("consumer " + modeName, numOps);
+                       });
+
+  std::thread producer([&aCircularBuffer, &go, &modeName] ()
+                       {
+                         circular_buffer::perfCounters counters {};
+                         uint64_t numOps {0};
+
+                         while ( !go.load(std::memory_order_acquire) ) { std::this_thread::yield(); }
+                         counters.start();
+                         for (cbtype item {0}; item < ITEMS_PER_PRODUCER; ++numOps)
+                         {
+                           if ( circular_buffer::cbBase::cbStatus::ADDED ==
+                                std::get<0>(aCircularBuffer.add(item)) )
+                           {
+                             ++item;
+                           }
+                         }
+                         counters.stop();
+                         counters.print("producer " + modeName, numOps);
+                       });
+
+  go.store(true, std::memory_order_release);
+  producer.join();
+  consumer.join();
+}  // perfCountersRun
+
+static
+void
+perfCountersBenchmark() noexcept(false)
+{
+  std::cout << "[" << __func__ << "] STARTING\n\n";
+
+  perfCountersRun(cbAddMode::MUTEX, "mutex");
+  perfCountersRun(cbAddMode::FLAT_COMBINING, "flat-combining");
+
+  std::cout << "\n[" << __func__ << "] "
+            << "TERMINATED\n";
+}  // perfCountersBenchmark
+#endif
+
+// Number of timers scheduled in the timer benchmarks; one in every
+// TIMERS_CANCEL_RATIO of them is cancelled before it expires
+static constexpr uint32_t NUM_TIMERS {500'000};
+static constexpr uint32_t TIMERS_CANCEL_RATIO {2};
+// Timeouts are in [1, MAX_TIMEOUT] ticks
+static constexpr uint64_t MAX_TIMEOUT {100'000};
+
+static
+std::vector<uint64_t>
+timerDelays() noexcept(false)
+{
+  std::mt19937_64 generator {42};
+  std::uniform_int_distribution<uint64_t> distribution {1, MAX_TIMEOUT};
+  std::vector<uint64_t> delays(NUM_TIMERS);
+
+  std::generate(delays.begin(), delays.end(), [&] () { return distribution(generator); });
+  return delays;
+}  // timerDelays
+
+// schedule all the timers, cancel some of them, then tick until all the others
+// expired.
+// Return the elapsed time in milliseconds and the number of expired timers
+static
+std::tuple<double, uint64_t>
+timingWheelBenchmark(const std::vector<uint64_t>& delays) noexcept(false)
+{
+  circular_buffer::cbTimingWheel<uint32_t> wheel(NUM_TIMERS, 1'024, 128);
+  std::vector<circular_buffer::cbTimingWheel<uint32_t>::timerId> ids(NUM_TIMERS);
+  uint64_t numExpired {0};
+
+  const auto start {std::chrono::steady_clock::now()};
+  for (uint32_t i {0}; i < NUM_TIMERS; ++i)
+  {
+    ids[i] = std::get<1>(wheel.schedule(delays[i], i));
+  }
+  for (uint32_t i {0}; i < NUM_TIMERS; i += TIMERS_CANCEL_RATIO)
+  {
+    wheel.cancel(ids[i]);
+  }
+  while ( !wheel.isEmpty() )
+  {
+    numExpired += wheel.tick([] (uint32_t) {});
+  }
+  const std::chrono::duration<double, std::milli> elapsed {std::chrono::steady_clock::now() - start};
+
+  return std::make_tuple(elapsed.count(), numExpired);
+}  // timingWheelBenchmark
+
+// same as timingWheelBenchmark() with a binary heap: cancelled timers are
+// marked and skipped when they reach the top of the heap
+static
+std::tuple<double, uint64_t>
+heapBenchmark(const std::vector<uint64_t>& delays) noexcept(false)
+{
+  using timer_t = std::tuple<uint64_t, uint32_t>;
+  std::priority_queue<timer_t, std::vector<timer_t>, std::greater<timer_t>> heap {};
+  std::vector<bool> cancelled(NUM_TIMERS, false);
+  uint64_t now {0};
+  uint64_t numExpired {0};
+
+  const auto start {std::chrono::steady_clock::now()};
+  for (uint32_t i {0}; i < NUM_TIMERS; ++i)
+  {
+    heap.emplace(now + delays[i], i);
+  }
+  for (uint32_t i {0}; i < NUM_TIMERS; i += TIMERS_CANCEL_RATIO)
+  {
+    cancelled[i] = true;
+  }
+  while ( !heap.empty() )
+  {
+    ++now;
+    while ( !heap.empty() && (std::get<0>(heap.top()) <= now) )
+    {
+      if ( !cancelled[std::get<1>(heap.top())] )
+      {
+        ++numExpired;
+      }
+      heap.pop();
+    }
+  }
+  const std::chrono::duration<double, std::milli> elapsed {std::chrono::steady_clock::now() - start};
+
+  return std::make_tuple(elapsed.count(), numExpired);
+}  // heapBenchmark
+
+static
+void
+timersBenchmark() noexcept(false)
+{
+  std::cout << "[" << __func__ << "] STARTING\n\n"
+            << "[" << __func__ << "] "
+            << NUM_TIMERS << " timers, timeouts in [1, " << MAX_TIMEOUT << "] ticks, "
+            << "1 in " << TIMERS_CANCEL_RATIO << " cancelled\n";
+
+  const auto delays {timerDelays()};
+  const auto [wheelTime, wheelExpired] = timingWheelBenchmark(delays);
+  const auto [heapTime, heapExpired] = heapBenchmark(delays);
+
+  std::cout << "[" << __func__ << "] "
+            << std::fixed << std::setprecision(2)
+            << "timing wheel: " << wheelTime << " ms, " << wheelExpired << " expired\n"
+            << "[" << __func__ << "] "
+            << "binary heap:  " << heapTime << " ms, " << heapExpired << " expired\n";
+
+  std::cout << "\n[" << __func__ << "] "
+            << "TERMINATED\n";
+}  // timersBenchmark
+
+// Large messages handed from a producer thread to a consumer thread
+using message_t = std::array<uint64_t, 512>;
+static constexpr uint32_t NUM_MESSAGES {200'000};
+static constexpr uint32_t MESSAGE_SLOTS {64};
+
+// the messages are built by the producer, copied into the buffer, and copied
+// out of it by the consumer.
+// Return the throughput in millions of messages per second
+static
+double
+copyHandoffBenchmark() noexcept(false)
+{
+  const circular_buffer::cb<message_t> aCircularBuffer(MESSAGE_SLOTS);
+  uint64_t checksum {0};
+
+  const auto start {std::chrono::steady_clock::now()};
+  std::thread producer([&aCircularBuffer] ()
+                       {
+                         message_t message {};
+                         for (uint32_t n {0}; n < NUM_MESSAGES; )
+                         {
+                           message.fill(n);
+                           if ( circular_buffer::cbBase::cbStatus::ADDED ==
+                                std::get<0>(aCircularBuffer.add(message)) )
+                           {
+                             ++n;
+                           }
+                           else
+                           {
+                             std::this_thread::yield();
+                           }
+                         }
+                       });
+  for (uint32_t n {0}; n < NUM_MESSAGES; )
+  {
+    auto [cbS, message, numElements] = aCircularBuffer.remove();
+    if ( circular_buffer::cbBase::cbStatus::REMOVED == cbS )
+    {
+      checksum += message.back();
+      ++n;
+    }
+    else
+    {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - start};
+
+  // keep the reads of the messages
+  std::cout << "[" << __func__ << "] checksum " << checksum << "\n";
+  return NUM_MESSAGES / elapsed.count() / 1e6;
+}  // copyHandoffBenchmark
+
+// the messages are built and read in place in the slab: only their indexes
+// go through the buffers.
+// Return the throughput in millions of messages per second
+static
+double
+slabHandoffBenchmark() noexcept(false)
+{
+  const circular_buffer::cbSlab<message_t> aSlab(MESSAGE_SLOTS);
+  uint64_t checksum {0};
+
+  const auto start {std::chrono::steady_clock::now()};
+  std::thread producer([&aSlab] ()
+                       {
+                         for (uint32_t n {0}; n < NUM_MESSAGES; )
+                         {
+                           auto [cbS, i] = aSlab.acquire();
+                           if ( circular_buffer::cbBase::cbStatus::FOUND == cbS )
+                           {
+                             aSlab[i].fill(n++);
+                             aSlab.publish(i);
+                           }
+                           else
+                           {
+                             std::this_thread::yield();
+                           }
+                         }
+                       });
+  for (uint32_t n {0}; n < NUM_MESSAGES; )
+  {
+    auto [cbS, i] = aSlab.consume();
+    if ( circular_buffer::cbBase::cbStatus::REMOVED == cbS )
+    {
+      checksum += aSlab[i].back();
+      aSlab.release(i);
+      ++n;
+    }
+    else
+    {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - start};
+
+  std::cout << "[" << __func__ << "] checksum " << checksum << "\n";
+  return NUM_MESSAGES / elapsed.count() / 1e6;
+}  // slabHandoffBenchmark
+
+static
+void
+slabBenchmark() noexcept(false)
+{
+  std::cout << "[" << __func__ << "] STARTING\n\n"
+            << "[" << __func__ << "] "
+            << NUM_MESSAGES << " messages of " << sizeof(message_t) << " bytes, "
+            << MESSAGE_SLOTS << " slots\n";
+
+  const double copyThroughput {copyHandoffBenchmark()};
+  const double slabThroughput {slabHandoffBenchmark()};
+
+  std::cout << "[" << __func__ << "] "
+            << std::fixed << std::setprecision(2)
+            << "copy through cb: " << copyThroughput << " Mmsg/s\n"
+            << "[" << __func__ << "] "
+            << "slab indexes:    " << slabThroughput << " Mmsg/s\n";
+
+  std::cout << "\n[" << __func__ << "] "
+            << "TERMINATED\n";
+}  // slabBenchmark
+
+// Number of log calls of the logger benchmarks
+static constexpr uint32_t NUM_LOGS {200'000};
+
+// log lines formatted by the calling thread in a stringstream and written
+// under a global mutex.
+// Return the average time of a log call in nanoseconds
+static
+double
+streamLogBenchmark(std::ostream& os) noexcept(false)
+{
+  std::mutex coutMutex {};
+
+  const auto start {std::chrono::steady_clock::now()};
+  for (uint32_t i {0}; i < NUM_LOGS; ++i)
+  {
+    std::stringstream ss {};
+
+    ss << "[" << __func__ << "] " << "ADDED" << " - item: " << i << " - num of elements: " << i % CBSIZE << "\n";
+    std::lock_guard<std::mutex> lg(coutMutex);
+    os << ss.rdbuf();
+  }
+  const std::chrono::duration<double, std::nano> elapsed {std::chrono::steady_clock::now() - start};
+
+  return elapsed.count() / NUM_LOGS;
+}  // streamLogBenchmark
+
+// same log lines written by the binary logger: the calling thread only
+// writes the format id and the arguments in its buffer.
+// Return the average time of a log call in nanoseconds, and the number of
+// records dropped because the logger thread was behind
+static
+std::tuple<double, uint64_t>
+binaryLogBenchmark(std::ostream& os) noexcept(false)
+{
+  const uint32_t format {circular_buffer::cbLogger::registerFormat("[{}] {} - item: {} - num of elements: {}\n")};
+  // a buffer holding all the records: none is dropped, so that every call is
+  // measured doing the same work
+  const circular_buffer::cbLogger aLogger(os, NUM_LOGS, std::chrono::microseconds(100));
+
+  const auto start {std::chrono::steady_clock::now()};
+  for (uint32_t i {0}; i < NUM_LOGS; ++i)
+  {
+    circular_buffer::cbLogger::log(format, __func__, "ADDED", i, i % CBSIZE);
+  }
+  const std::chrono::duration<double, std::nano> elapsed {std::chrono::steady_clock::now() - start};
+
+  return std::make_tuple(elapsed.count() / NUM_LOGS, circular_buffer::cbLogger::getNumDropped());
+}  // binaryLogBenchmark
+
+static
+void
+loggerBenchmark() noexcept(false)
+{
+  std::cout << "[" << __func__ << "] STARTING\n\n"
+            << "[" << __func__ << "] "
+            << NUM_LOGS << " log calls, output discarded\n";
+
+  // a stream without buffer: everything is formatted, nothing is written
+  std::ostream nullStream {nullptr};
+  const double streamTime {streamLogBenchmark(nullStream)};
+  const auto [binaryTime, numDropped] = binaryLogBenchmark(nullStream);
+
+  std::cout << "[" << __func__ << "] "
+            << std::fixed << std::setprecision(2)
+            << "stringstream + mutex: " << streamTime << " ns per call\n"
+            << "[" << __func__ << "] "
+            << "binary logger:        " << binaryTime << " ns per call, "
+            << numDropped << " dropped\n";
+
+  std::cout << "\n[" << __func__ << "] "
+            << "TERMINATED\n";
+}  // loggerBenchmark
+
+auto
+main() -> int
+{
+  std::cout << "\n[" << __func__ << "] STARTING\n\n";
+
+  flatCombiningBenchmark();
+
+  std::cout << "\n------------------------------------\n\n";
+
+#ifdef DO_PERF_COUNTERS
+  perfCountersBenchmark();
+
+  std::cout << "\n------------------------------------\n\n";
+#endif
+
+  timersBenchmark();
+
+  std::cout << "\n------------------------------------\n\n";
+
+  slabBenchmark();
+
+  std::cout << "\n------------------------------------\n\n";
+
+  loggerBenchmark();
+
+  std::cout << "\n[" << __func__ << "] "
+            << "TERMINATED\n\n";
+}  // main
@@ -0,0 +1,313 @@
+/*
+ * File:   binaryLogger.cpp
+ */
+#include "binaryLogger.h"
+#include <charconv>
+////////////////////////////////////////////////////////////////////////////////
+namespace circular_buffer
+{
+struct cbLogger::registry
+{
+  std::mutex m_mx {};
+  std::vector<std::string> m_formats {};
+  std::vector<ring_shptr_t> m_rings {};
+  // held by flush() while it drains: the logger cannot be destroyed meanwhile;
+  // taken before m_mx
+  std::mutex m_loggerMx {};
+  // records dropped by the buffers of threads already terminated
+  uint64_t m_numDropped {0};
+  cbLogger* m_pLogger {nullptr};
+};
+
+thread_local cbLogger::ring_shptr_t cbLogger::m_pThreadRing {};
+thread_local uint64_t cbLogger::m_threadGeneration {0};
+
+cbLogger::registry&
+cbLogger::_registry() noexcept
+{
+  static registry theRegistry {};
+
+  return theRegistry;
+}
+
+// the buffer of the calling thread, allocated at the first log call of the
+// thread for the current logger; nullptr when there is no logger
+cbLogger::threadRing*
+cbLogger::_threadRing() noexcept
+{
+  if ( !m_active.load(std::memory_order_acquire) )
+  {
+    return nullptr;
+  }
+  if ( m_generation.load(std::memory_order_acquire) == m_threadGeneration )
+  {
+    return m_pThreadRing.get();
+  }
+
+  registry& r {_registry()};
+  std::lock_guard<std::mutex> rlg(r.m_mx);
+
+  m_threadGeneration = m_generation.load(std::memory_order_relaxed);
+  m_pThreadRing.reset();
+  if ( nullptr == r.m_pLogger )
+  {
+    return nullptr;
+  }
+  try
+  {
+    m_pThreadRing = std::make_shared<threadRing>(r.m_pLogger->m_ringSize);
+    r.m_rings.push_back(m_pThreadRing);
+  }
+  catch ( ... )
+  {
+    // no memory: this thread does not log
+    m_pThreadRing.reset();
+  }
+  return m_pThreadRing.get();
+}
+
+// replace every {} in the format with the next argument of the record;
+// placeholders without an argument are left out
+void
+cbLogger::_format(const logRecord& record,
+                  const std::string& format,
+                  std::string& text) noexcept(false)
+{
+  size_t start {0};
+  size_t arg {0};
+
+  while ( true )
+  {
+    const size_t pos {format.find("{}", start)};
+
+    text.append(format, start, (std::string::npos == pos) ? std::string::npos : pos - start);
+    if ( std::string::npos == pos )
+    {
+      return;
+    }
+    start = pos + 2;
+    if ( arg >= record.m_numArgs )
+    {
+      continue;
+    }
+
+    const uint64_t value {record.m_args[arg]};
+    char chars[32] {};
+    std::to_chars_result tcr {chars, std::errc {}};
+
+    switch (record.m_types[arg++])
+    {
+      case argType::BOOL:
+        text.append(value ? "true" : "false");
+        break;
+
+      case argType::CHAR:
+        text.push_back(static_cast<char>(value));
+        break;
+
+      case argType::INT:
+        tcr = std::to_chars(chars, chars + sizeof(chars), static_cast<int64_t>(value));
+        break;
+
+      case argType::UINT:
+        tcr = std::to_chars(chars, chars + sizeof(chars), value);
+        break;
+
+      case argType::DOUBLE:
+        tcr = std::to_chars(chars, chars + sizeof(chars), std::bit_cast<double>(value));
+        break;
+
+      case argType::STRING:
+        text.append(reinterpret_cast<const char*>(static_cast<uintptr_t>(value)));
+        break;
+
+      case argType::NONE:
+        break;
+    }
+    text.append(chars, tcr.ptr);
+  }
+}
+
+// format and write the records of all the buffers; return false when there
+// were none
+bool
+cbLogger::_drain() noexcept(false)
+{
+  std::lock_guard<std::mutex> dlg(m_drainMutex);
+  registry& r {_registry()};
+
+  {
+    std::lock_guard<std::mutex> rlg(r.m_mx);
+
+    // forget the empty buffers of the threads already terminated
+    std::erase_if(r.m_rings, [&r] (const ring_shptr_t& pRing)
+                             {
+                               if ( (1 == pRing.use_count()) && pRing->m_records.isEmpty() )
+                               {
+                                 r.m_numDropped += pRing->m_numDropped.load(std::memory_order_relaxed);
+                                 return true;
+                               }
+                               return false;
+                             });
+    m_activeRings = r.m_rings;
+  }
+
+  // at most one buffer size per thread: a thread logging fast does not keep
+  // the others waiting
+  m_batch.clear();
+  for (const auto& pRing : m_activeRings)
+  {
+    for (unsigned long n {pRing->m_records.getNumElements()}; n > 0; --n)
+    {
+      m_batch.push_back(std::get<1>(pRing->m_records.remove()));
+    }
+  }
+  m_activeRings.clear();
+  if ( m_batch.empty() )
+  {
+    return false;
+  }
+
+  std::stable_sort(m_batch.begin(), m_batch.end(),
+                   [] (const logRecord& a, const logRecord& b) { return a.m_timestamp < b.m_timestamp; });
+
+  m_text.clear();
+  {
+    std::lock_guard<std::mutex> rlg(r.m_mx);
+
+    for (const auto& record : m_batch)
+    {
+      if ( record.m_formatId < r.m_formats.size() )
+      {
+        _format(record, r.m_formats[record.m_formatId], m_text);
+      }
+    }
+  }
+  if ( nullptr != m_pOsMutex )
+  {
+    std::lock_guard<std::mutex> olg(*m_pOsMutex);
+
+    m_os << m_text;
+    m_os.flush();
+  }
+  else
+  {
+    m_os << m_text;
+    m_os.flush();
+  }
+
+  return true;
+}
+
+void
+cbLogger::_run() noexcept(false)
+{
+  while ( !m_stopped.load(std::memory_order_acquire) )
+  {
+    if ( !_drain() )
+    {
+      std::this_thread::sleep_for(m_flushInterval);
+    }
+  }
+}
+
+cbLogger::cbLogger(std::ostream& os,
+                   const unsigned long ringSize,
+                   const std::chrono::microseconds flushInterval,
+                   std::mutex* const pOsMutex) noexcept(false)
+:
+m_os(os),
+m_pOsMutex(pOsMutex),
+m_ringSize(ringSize),
+m_flushInterval(flushInterval)
+{
+  if ( 0 == m_ringSize )
+  {
+    throw std::invalid_argument("ERROR: The size of the log buffers must not be zero");
+  }
+
+  registry& r {_registry()};
+  {
+    std::lock_guard<std::mutex> rlg(r.m_mx);
+
+    if ( nullptr != r.m_pLogger )
+    {
+      throw std::invalid_argument("ERROR: A logger already exists");
+    }
+    r.m_pLogger = this;
+    r.m_numDropped = 0;
+    // threads start from generation 0: the first logger is 1
+    m_generation.fetch_add(1, std::memory_order_release);
+    m_active.store(true, std::memory_order_release);
+  }
+
+  m_thread = std::thread(&cbLogger::_run, this);
+}
+
+cbLogger::~cbLogger()
+{
+  m_stopped.store(true, std::memory_order_release);
+  m_thread.join();
+
+  registry& r {_registry()};
+  {
+    std::lock_guard<std::mutex> llg(r.m_loggerMx);
+    std::lock_guard<std::mutex> rlg(r.m_mx);
+
+    r.m_pLogger = nullptr;
+    m_active.store(false, std::memory_order_release);
+  }
+  while ( _drain() )
+  {
+  }
+
+  std::lock_guard<std::mutex> rlg(r.m_mx);
+  r.m_rings.clear();
+}
+
+uint32_t
+cbLogger::registerFormat(const std::string& format) noexcept(false)
+{
+  registry& r {_registry()};
+  std::lock_guard<std::mutex> rlg(r.m_mx);
+
+  r.m_formats.push_back(format);
+
+  return static_cast<uint32_t>(r.m_formats.size() - 1);
+}
+
+void
+cbLogger::flush() noexcept(false)
+{
+  registry& r {_registry()};
+  // the destructor of the logger waits for the drain to be done
+  std::lock_guard<std::mutex> llg(r.m_loggerMx);
+  cbLogger* pLogger {nullptr};
+
+  {
+    std::lock_guard<std::mutex> rlg(r.m_mx);
+
+    pLogger = r.m_pLogger;
+  }
+  // one pass is enough: it takes all the records already in the buffers
+  if ( nullptr != pLogger )
+  {
+    pLogger->_drain();
+  }
+}
+
+uint64_t
+cbLogger::getNumDropped() noexcept
+{
+  registry& r {_registry()};
+  std::lock_guard<std::mutex> rlg(r.m_mx);
+  uint64_t numDropped {r.m_numDropped};
+
+  for (const auto& pRing : r.m_rings)
+  {
+    numDropped += pRing->m_numDropped.load(std::memory_order_relaxed);
+  }
+  return numDropped;
+}
+}  // namespace circular_buffer
+////////////////////////////////////////////////////////////////////////////////
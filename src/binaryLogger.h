@@ -0,0 +1,204 @@
+/*
+ * File:   binaryLogger.h
+ */
+#pragma once
+
+#include "circularBuffer.h"
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+////////////////////////////////////////////////////////////////////////////////
+namespace circular_buffer
+{
+// Asynchronous binary logger.
+// A log call does no formatting and no I/O: it writes the id of a registered
+// format, a timestamp, and the raw arguments in a circular buffer owned by the
+// calling thread. A background thread drains the buffers of all the threads,
+// sorts each batch of records by timestamp, formats it, and writes it to the
+// output stream in one go.
+// Formats are registered once, typically at start up, and use {} as the
+// placeholder of the next argument. Arguments are bools, chars, integers,
+// floating points, or C strings; C strings must outlive the logger (string
+// literals, __func__, cbStatusString()) since only their address is logged.
+// When the buffer of a thread is full the record is dropped and counted.
+// There is one logger at a time in the process: log() is a no-op when no
+// cbLogger object exists
+class cbLogger final
+{
+ public:
+  constexpr static inline size_t m_maxArgs {6};
+
+  enum class argType : uint8_t {NONE, BOOL, CHAR, INT, UINT, DOUBLE, STRING};
+
+  // what a log call writes: a literal type, so that it can be stored in a cb
+  struct logRecord
+  {
+    uint64_t m_timestamp {0};
+    uint32_t m_formatId {0};
+    uint8_t m_numArgs {0};
+    std::array<argType, m_maxArgs> m_types {};
+    std::array<uint64_t, m_maxArgs> m_args {};
+  };
+
+ private:
+  struct threadRing
+  {
+    const cb<logRecord> m_records;
+    std::atomic<uint64_t> m_numDropped {0};
+
+    explicit
+    threadRing(const unsigned long size)
+    :
+    m_records(size)
+    {}
+  };
+
+  using ring_shptr_t = std::shared_ptr<threadRing>;
+
+  // the buffers of the threads and the formats; built at first use, so that
+  // formats can be registered during static initialization
+  struct registry;
+
+  // increased at every logger construction, never reset, so that threads
+  // notice their buffer belongs to a previous logger
+  static inline std::atomic<uint64_t> m_generation {0};
+  // whether a logger exists
+  static inline std::atomic<bool> m_active {false};
+  static thread_local ring_shptr_t m_pThreadRing;
+  static thread_local uint64_t m_threadGeneration;
+
+  std::ostream& m_os;
+  // taken while writing, when the stream is shared with other writers
+  std::mutex* const m_pOsMutex {nullptr};
+  const unsigned long m_ringSize {};
+  const std::chrono::microseconds m_flushInterval {};
+  std::atomic<bool> m_stopped {false};
+  // accessed by the thread draining the buffers only
+  std::mutex m_drainMutex {};
+  std::vector<ring_shptr_t> m_activeRings {};
+  std::vector<logRecord> m_batch {};
+  std::string m_text {};
+  std::thread m_thread {};
+
+  template <typename A>
+  static
+  void
+  _encode(logRecord& record, const A& arg) noexcept
+  {
+    using D = std::decay_t<A>;
+    const size_t i {record.m_numArgs++};
+
+    if constexpr ( std::is_same<D, bool>::value )
+    {
+      record.m_types[i] = argType::BOOL;
+      record.m_args[i] = arg;
+    }
+    else if constexpr ( std::is_same<D, char>::value )
+    {
+      record.m_types[i] = argType::CHAR;
+      record.m_args[i] = static_cast<unsigned char>(arg);
+    }
+    else if constexpr ( std::is_integral<D>::value && std::is_signed<D>::value )
+    {
+      record.m_types[i] = argType::INT;
+      record.m_args[i] = static_cast<uint64_t>(static_cast<int64_t>(arg));
+    }
+    else if constexpr ( std::is_integral<D>::value )
+    {
+      record.m_types[i] = argType::UINT;
+      record.m_args[i] = static_cast<uint64_t>(arg);
+    }
+    else if constexpr ( std::is_floating_point<D>::value )
+    {
+      record.m_types[i] = argType::DOUBLE;
+      record.m_args[i] = std::bit_cast<uint64_t>(static_cast<double>(arg));
+    }
+    else if constexpr ( std::is_same<D, const char*>::value || std::is_same<D, char*>::value )
+    {
+      record.m_types[i] = argType::STRING;
+      record.m_args[i] = reinterpret_cast<uintptr_t>(static_cast<const char*>(arg));
+    }
+    else
+    {
+      static_assert(sizeof(D) == 0, "unsupported type of log argument");
+    }
+  }
+
+  static registry& _registry() noexcept;
+  static threadRing* _threadRing() noexcept;
+  static void _format(const logRecord& record, const std::string& format, std::string& text) noexcept(false);
+  bool _drain() noexcept(false);
+  void _run() noexcept(false);
+
+ public:
+  // we don't want these objects allocated on the heap
+  void* operator new(std::size_t) = delete;
+  void* operator new[](std::size_t) = delete;
+
+  void operator delete(void*) = delete;
+  void operator delete[](void*) = delete;
+
+  cbLogger(const cbLogger&) = delete;
+  cbLogger& operator= (const cbLogger&) = delete;
+  cbLogger(const cbLogger&&) = delete;
+  cbLogger& operator= (const cbLogger&&) = delete;
+
+  // start the background thread; ringSize is the number of records of the
+  // buffer of each logging thread, flushInterval the sleep of the background
+  // thread when all the buffers are empty, pOsMutex the mutex other writers of
+  // the stream use, if any
+  explicit
+  cbLogger(std::ostream& os,
+           unsigned long ringSize = 4'096,
+           std::chrono::microseconds flushInterval = std::chrono::microseconds(1'000),
+           std::mutex* pOsMutex = nullptr) noexcept(false);
+
+  // write all the pending records, then stop the background thread.
+  // The threads still logging must be done before
+  ~cbLogger();
+
+  // return the id of the format, to be given to log()
+  static uint32_t registerFormat(const std::string& format) noexcept(false);
+
+  // log a record: ADDED, FULL when dropped because the buffer of the thread is
+  // full, UNKNOWN when there is no logger
+  template <typename... Args>
+  static
+  cbBase::cbStatus
+  log(const uint32_t formatId, const Args&... args) noexcept
+  {
+    static_assert(sizeof...(Args) <= m_maxArgs, "too many arguments for a log record");
+
+    threadRing* pRing {_threadRing()};
+
+    if ( nullptr == pRing )
+    {
+      return cbBase::cbStatus::UNKNOWN;
+    }
+
+    logRecord record {};
+    record.m_timestamp = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    record.m_formatId = formatId;
+    (_encode(record, args), ...);
+
+    const auto cbS {std::get<0>(pRing->m_records.add(record))};
+    if ( cbBase::cbStatus::FULL == cbS )
+    {
+      pRing->m_numDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    return cbS;
+  }
+
+  // write all the records logged so far, from the calling thread
+  static void flush() noexcept(false);
+
+  // number of records dropped since the logger was created
+  static uint64_t getNumDropped() noexcept;
+};  // class cbLogger
+}  // namespace circular_buffer
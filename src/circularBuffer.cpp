@@ -12,6 +12,10 @@ cbBase::statusStringMap const cbBase::m_statusStrings
   ,{ cbBase::cbStatus::ADDED,   "ADDED"}
   ,{ cbBase::cbStatus::REMOVED, "REMOVED"}
   ,{ cbBase::cbStatus::FULL,    "FULL"}
+  ,{ cbBase::cbStatus::FOUND,   "FOUND"}
+  ,{ cbBase::cbStatus::EVICTED, "EVICTED"}
+  ,{ cbBase::cbStatus::NOT_PRODUCED, "NOT_PRODUCED"}
+  ,{ cbBase::cbStatus::CONFLATED, "CONFLATED"}
 };
 
 cbBase::cbBase(const unsigned long cbSize) noexcept(false)
@@ -55,6 +59,39 @@ cbBase::isPopulated() const noexcept
 
   return (m_numElements > 0);
 }
+
+// Enable the watermarks: when the number of elements goes up to high, the
+// above-high-watermark flag is set and onWatermark(HIGH, n) is called; the flag
+// is cleared and onWatermark(LOW, n) is called only when the number of elements
+// goes back down to low, so that producers are not toggled at every action.
+// The flag is flipped under the lock by the action crossing the watermark;
+// the callback is called right after, without the lock: it may use the
+// circular buffer, should be short, and must not throw.
+// To be called before the circular buffer is shared between threads
+void
+cbBase::setWatermarks(const unsigned long high,
+                      const unsigned long low,
+                      const watermark_fn& onWatermark) const noexcept(false)
+{
+  if ( (0 == high) || (high > m_cbSize) || (low >= high) )
+  {
+    throw std::invalid_argument("ERROR: The watermarks must be 0 <= low < high <= size");
+  }
+
+  std::lock_guard<std::mutex> mlg(m_mx);
+
+  m_highWatermark = high;
+  m_lowWatermark = low;
+  m_onWatermark = onWatermark;
+  m_aboveHighWatermark.store(m_numElements >= high, std::memory_order_relaxed);
+  m_notifiedAboveHighWatermark.store(m_numElements >= high, std::memory_order_relaxed);
+}
+
+bool
+cbBase::isAboveHighWatermark() const noexcept
+{
+  return m_aboveHighWatermark.load(std::memory_order_acquire);
+}
 }  // namespace circular_buffer
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -3,12 +3,20 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <functional>
 #include <iostream>
 #include <iomanip>
 #include <string>
 #include <mutex>
 #include <map>
 #include <memory>
+#include <span>
+#include <sys/uio.h>
+#include <type_traits>
+#include <thread>
 #include <tuple>
 ////////////////////////////////////////////////////////////////////////////////
 namespace circular_buffer
@@ -28,12 +36,26 @@ class cbBase
   explicit cbBase(unsigned long cbSize) noexcept(false);
 
  public:
-  enum class cbStatus : uint8_t {UNKNOWN, EMPTY, ADDED, REMOVED, FULL};
+  enum class cbStatus : uint8_t {UNKNOWN, EMPTY, ADDED, REMOVED, FULL,
+                                 FOUND, EVICTED, NOT_PRODUCED, CONFLATED};
+  // MUTEX: every add() takes the lock;
+  // FLAT_COMBINING: add() takes the lock when free, otherwise it publishes the
+  // item in a per-thread slot and the thread holding the lock adds all the
+  // published items in one go
+  enum class cbAddMode : uint8_t {MUTEX, FLAT_COMBINING};
+  // HIGH: the number of elements went up to the high watermark;
+  // LOW: it went back down to the low watermark
+  enum class cbWatermark : uint8_t {HIGH, LOW};
+  using watermark_fn = std::function<void(cbWatermark, unsigned long)>;
 
   unsigned long getNumElements() const noexcept;
   bool isEmpty() const noexcept;
   bool isFull() const noexcept;
   bool isPopulated() const noexcept;
+  void setWatermarks(unsigned long high,
+                     unsigned long low,
+                     const watermark_fn& onWatermark = {}) const noexcept(false);
+  bool isAboveHighWatermark() const noexcept;
 
   const
   std::string&
@@ -54,6 +76,7 @@ class cbBase
 
  protected:
   using cbaddret = std::tuple<cbBase::cbStatus, size_t>;
+  using cbaddseqret = std::tuple<cbBase::cbStatus, size_t, uint64_t>;
   using statusStringMap = std::map<cbStatus, std::string>;
   static inline const unsigned long m_defaultSize {3};
   static statusStringMap const m_statusStrings;
@@ -63,6 +86,78 @@ class cbBase
   mutable std::mutex m_mx {};
   mutable unsigned long m_readIndex {0};
   mutable unsigned long m_numElements {0};
+  // the sequence number of the item at m_readIndex: every add() gives the item
+  // the sequence number m_headSequence + m_numElements
+  mutable uint64_t m_headSequence {0};
+  // watermarks on the number of elements, disabled when m_highWatermark is 0
+  mutable unsigned long m_highWatermark {0};
+  mutable unsigned long m_lowWatermark {0};
+  mutable watermark_fn m_onWatermark {};
+  // set and cleared under the lock
+  mutable std::atomic<bool> m_aboveHighWatermark {false};
+  // the state given to the last callback, and whether a thread is calling it
+  mutable std::atomic<bool> m_notifiedAboveHighWatermark {false};
+  mutable std::atomic<bool> m_notifying {false};
+
+  // flip the flag when the number of elements crossed a watermark; the lock
+  // must be held, so that the flag always agrees with the number of elements
+  void
+  _updateWatermarks() const noexcept
+  {
+    if ( 0 == m_highWatermark )
+    {
+      return;
+    }
+
+    const bool above {m_aboveHighWatermark.load(std::memory_order_relaxed)};
+
+    if ( !above && (m_numElements >= m_highWatermark) )
+    {
+      m_aboveHighWatermark.store(true, std::memory_order_seq_cst);
+    }
+    else if ( above && (m_numElements <= m_lowWatermark) )
+    {
+      m_aboveHighWatermark.store(false, std::memory_order_seq_cst);
+    }
+  }
+
+  // call the callback until the last notified state agrees with the flag;
+  // called without the lock after every action, numElements being the number
+  // of elements the action left.
+  // One thread at a time notifies: a thread finding another one notifying
+  // leaves, and the notifying thread checks the flag again before leaving, so
+  // HIGH and LOW notifications always alternate, the last one matches the
+  // flag, and the callback may use the circular buffer. The callback must not
+  // throw
+  void
+  _notifyWatermarks(const unsigned long numElements) const noexcept
+  {
+    if ( 0 == m_highWatermark )
+    {
+      return;
+    }
+
+    while ( m_aboveHighWatermark.load(std::memory_order_seq_cst) !=
+            m_notifiedAboveHighWatermark.load(std::memory_order_relaxed) )
+    {
+      if ( m_notifying.exchange(true, std::memory_order_seq_cst) )
+      {
+        return;
+      }
+
+      const bool above {m_aboveHighWatermark.load(std::memory_order_seq_cst)};
+
+      if ( above != m_notifiedAboveHighWatermark.load(std::memory_order_relaxed) )
+      {
+        m_notifiedAboveHighWatermark.store(above, std::memory_order_relaxed);
+        if ( m_onWatermark )
+        {
+          m_onWatermark(above ? cbWatermark::HIGH : cbWatermark::LOW, numElements);
+        }
+      }
+      m_notifying.store(false, std::memory_order_seq_cst);
+    }
+  }
 
   constexpr
   bool
@@ -84,10 +179,133 @@ template <typename T = int>
 class cb final : public cbBase
 {
   using cbremret = std::tuple<cbBase::cbStatus, T, size_t>;
+  // status and number of bytes transferred, -1 on error (see errno)
+  using cbioret = std::tuple<cbBase::cbStatus, ssize_t>;
 
  private:
   constexpr static inline T m_noItem {};
 
+  // flat combining: states of a publication slot
+  enum fcState : uint8_t {FC_FREE, FC_CLAIMED, FC_PENDING, FC_DONE};
+  constexpr static inline size_t m_numFCSlots {64};
+
+  // a publication slot has its own cache line: threads spin on their own slot
+  struct alignas(64) fcSlot
+  {
+    std::atomic<uint8_t> m_state {FC_FREE};
+    T m_item {};
+    cbBase::cbStatus m_status {cbBase::cbStatus::UNKNOWN};
+    size_t m_numElements {0};
+    uint64_t m_sequence {0};
+  };
+
+  static_assert(m_numFCSlots <= 64, "a slot is a bit of m_fcPendingSlots");
+
+  static inline std::atomic<size_t> m_fcNextThreadIndex {0};
+
+  const cbAddMode m_addMode {cbAddMode::MUTEX};
+  // allocated only in flat combining mode
+  std::unique_ptr<fcSlot[]> m_pFCSlots {};
+  // bit i set when slot i holds a pending item: the combiner visits only those
+  mutable std::atomic<uint64_t> m_fcPendingSlots {0};
+
+  // bytes of the first item already written by drainTo(), and bytes of the item
+  // after the last one already read by fillFrom(), after partial transfers
+  mutable size_t m_drainOffset {0};
+  mutable size_t m_fillOffset {0};
+
+  // add an item; the lock must be held
+  cbaddseqret
+  _add(const T& item) const noexcept
+  {
+    const uint64_t sequence {m_headSequence + m_numElements};
+
+    if ( _isFull() )
+    {
+      // until C++17
+      return std::make_tuple(cbBase::cbStatus::FULL, m_cbSize, sequence);
+    }
+
+    m_pData.get()[(m_readIndex + m_numElements) % m_cbSize] = item;
+    ++m_numElements;
+    _updateWatermarks();
+
+    // until C++17
+    return std::make_tuple(cbBase::cbStatus::ADDED, m_numElements, sequence);
+  }
+
+  // add all the published items; the lock must be held
+  void
+  _combine() const noexcept
+  {
+    // a plain load first: no write to the shared mask when nobody published
+    if ( 0 == m_fcPendingSlots.load(std::memory_order_relaxed) )
+    {
+      return;
+    }
+
+    uint64_t pendingSlots {m_fcPendingSlots.exchange(0, std::memory_order_acquire)};
+
+    while ( 0 != pendingSlots )
+    {
+      fcSlot& slot {m_pFCSlots.get()[std::countr_zero(pendingSlots)]};
+
+      pendingSlots &= pendingSlots - 1;
+      std::tie(slot.m_status, slot.m_numElements, slot.m_sequence) = _add(slot.m_item);
+      slot.m_state.store(FC_DONE, std::memory_order_release);
+    }
+  }
+
+  cbaddseqret
+  _addCombining(const T& item) const noexcept
+  {
+    // no contention: add directly, serving first the threads that published
+    if ( m_mx.try_lock() )
+    {
+      _combine();
+
+      auto t = _add(item);
+      m_mx.unlock();
+      return t;
+    }
+
+    thread_local const size_t threadIndex {m_fcNextThreadIndex.fetch_add(1, std::memory_order_relaxed)};
+    const size_t slotIndex {threadIndex % m_numFCSlots};
+    fcSlot& slot {m_pFCSlots.get()[slotIndex]};
+
+    uint8_t expected {FC_FREE};
+    if ( !slot.m_state.compare_exchange_strong(expected, FC_CLAIMED, std::memory_order_acquire) )
+    {
+      // more threads than slots and the slot is in use: take the lock
+      std::lock_guard<std::mutex> lg(m_mx);
+      return _add(item);
+    }
+
+    slot.m_item = item;
+    slot.m_state.store(FC_PENDING, std::memory_order_relaxed);
+    m_fcPendingSlots.fetch_or(uint64_t {1} << slotIndex, std::memory_order_release);
+
+    while ( true )
+    {
+      if ( FC_DONE == slot.m_state.load(std::memory_order_acquire) )
+      {
+        auto t = std::make_tuple(slot.m_status, slot.m_numElements, slot.m_sequence);
+
+        slot.m_state.store(FC_FREE, std::memory_order_release);
+        return t;
+      }
+      // whoever gets the lock becomes the combiner and adds the items of all the
+      // threads, ours included, while the data stays in its cache
+      if ( m_mx.try_lock() )
+      {
+        _combine();
+        m_mx.unlock();
+        continue;
+      }
+      std::this_thread::yield();
+    }
+  }
+
  public:
   // we don't want these objects allocated on the heap
   void* operator new(std::size_t) = delete;
@@ -108,13 +326,26 @@ class cb final : public cbBase
   std::unique_ptr<T[]> m_pData {};
 
   explicit
-  cb(const unsigned long cbSize)
+  cb(const unsigned long cbSize, const cbAddMode addMode = cbAddMode::MUTEX)
   :
   cbBase(cbSize),
+  m_addMode(addMode),
   // allocate an array of T's having size cbSize and store the pointer to it in
   // the unique pointer
   m_pData (std::make_unique<T[]>(cbSize))
-  {}
+  {
+    if ( cbAddMode::FLAT_COMBINING == m_addMode )
+    {
+      m_pFCSlots = std::make_unique<fcSlot[]>(m_numFCSlots);
+    }
+  }
+
+  constexpr
+  cbAddMode
+  addMode() const noexcept
+  {
+    return m_addMode;
+  }
 
   void
   printData(const std::string&& caller = "caller-unspecified") const noexcept
@@ -168,22 +399,84 @@ class cb final : public cbBase
               << "\n";
   }
 
+  // add an item in the circular buffer, if not full; return the status, the
+  // number of items after the action, and the sequence number given to the
+  // item (meaningless when FULL)
+  cbaddseqret
+  addSeq(const T& item) const noexcept
+  {
+    if ( cbAddMode::FLAT_COMBINING == m_addMode )
+    {
+      auto t = _addCombining(item);
+
+      _notifyWatermarks(std::get<1>(t));
+      return t;
+    }
+
+    std::unique_lock<std::mutex> ul(m_mx);
+    auto t = _add(item);
+
+    ul.unlock();
+    _notifyWatermarks(std::get<1>(t));
+
+    return t;
+  }
+
   // add an item in the circular buffer, if not full
   cbaddret
   add(const T& item) const noexcept
+  {
+    auto [cbS, numElements, sequence] = addSeq(item);
+
+    return std::make_tuple(cbS, numElements);
+  }
+
+  // return the item having the given sequence number: FOUND and the item when
+  // still in the circular buffer, EVICTED when already removed, NOT_PRODUCED
+  // when not added yet
+  std::tuple<cbBase::cbStatus, T>
+  get(const uint64_t sequence) const noexcept
   {
     std::lock_guard<std::mutex> lg(m_mx);
 
-    if ( _isFull() )
+    if ( sequence < m_headSequence )
     {
-      // until C++17
-      return std::make_tuple(cbBase::cbStatus::FULL, m_cbSize);
+      return std::make_tuple(cbBase::cbStatus::EVICTED, m_noItem);
+    }
+    if ( sequence >= m_headSequence + m_numElements )
+    {
+      return std::make_tuple(cbBase::cbStatus::NOT_PRODUCED, m_noItem);
     }
 
-    m_pData.get()[(m_readIndex + m_numElements) % m_cbSize] = item;
+    return std::make_tuple(cbBase::cbStatus::FOUND,
+                           m_pData.get()[(m_readIndex + (sequence - m_headSequence)) % m_cbSize]);
+  }
 
-    // until C++17
-    return std::make_tuple(cbBase::cbStatus::ADDED, ++m_numElements);
+  // copy the items having sequence numbers in [from, to) to out, at most
+  // out.size() of them; return the status, as for get(), and the number of
+  // items copied
+  std::tuple<cbBase::cbStatus, size_t>
+  getRange(const uint64_t from, const uint64_t to, const std::span<T> out) const noexcept
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    if ( from < m_headSequence )
+    {
+      return std::make_tuple(cbBase::cbStatus::EVICTED, 0);
+    }
+    if ( (to > m_headSequence + m_numElements) || (from > to) )
+    {
+      return std::make_tuple(cbBase::cbStatus::NOT_PRODUCED, 0);
+    }
+
+    const size_t numItems {std::min(static_cast<size_t>(to - from), out.size())};
+    const unsigned long first {(m_readIndex + (from - m_headSequence)) % m_cbSize};
+    const size_t firstLength {std::min(numItems, static_cast<size_t>(m_cbSize - first))};
+
+    std::copy(m_pData.get() + first, m_pData.get() + first + firstLength, out.begin());
+    std::copy(m_pData.get(), m_pData.get() + (numItems - firstLength), out.begin() + firstLength);
+
+    return std::make_tuple(cbBase::cbStatus::FOUND, numItems);
   }
 
   // return the first item in the circular buffer, no changes in it
@@ -194,26 +487,137 @@ class cb final : public cbBase
     return m_pData.get()[m_readIndex];
   }
 
-  // remove the first item from the circular buffer, if not empty
+  // remove the first item from the circular buffer, if not empty.
+  // Return UNKNOWN and leave the item in place when drainTo() already wrote a
+  // part of it: only drainTo() can complete it without tearing the record
   cbremret
   remove() const noexcept
   {
-    std::lock_guard<std::mutex> lg(m_mx);
+    std::unique_lock<std::mutex> ul(m_mx);
 
     if ( _isEmpty() )
     {
       // until C++17
       return std::make_tuple(cbBase::cbStatus::EMPTY, m_noItem, 0);
     }
+    if ( 0 != m_drainOffset )
+    {
+      return std::make_tuple(cbBase::cbStatus::UNKNOWN, m_noItem, m_numElements);
+    }
 
     // until C++17
     auto t = std::make_tuple(cbBase::cbStatus::REMOVED, getFront(), --m_numElements);
 
     m_pData.get()[m_readIndex] = m_noItem;
     m_readIndex = (m_readIndex + 1) % m_cbSize;
+    ++m_headSequence;
+    _updateWatermarks();
+
+    ul.unlock();
+    _notifyWatermarks(std::get<2>(t));
 
     return t;
   }
+
+  // write the items in the circular buffer to the file descriptor with one
+  // writev() on (at most) two segments of the data, no intermediate copy.
+  // Only the items written completely are removed; the bytes of a partially
+  // written item are remembered and not written again by the next call, and
+  // remove() refuses that item meanwhile.
+  // The lock is held during the system call: a blocking fd that is not ready
+  // stalls all the producers and consumers, so prefer a non-blocking fd
+  cbioret
+  drainTo(const int fd) const noexcept
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "expected trivially copyable types");
+
+    std::unique_lock<std::mutex> ul(m_mx);
+
+    if ( _isEmpty() )
+    {
+      return std::make_tuple(cbBase::cbStatus::EMPTY, 0);
+    }
+
+    auto* pBytes {reinterpret_cast<std::byte*>(m_pData.get())};
+    const unsigned long firstLength {std::min(m_numElements, m_cbSize - m_readIndex)};
+    iovec iov[2] {};
+    iov[0].iov_base = pBytes + m_readIndex * sizeof(T) + m_drainOffset;
+    iov[0].iov_len = firstLength * sizeof(T) - m_drainOffset;
+    iov[1].iov_base = pBytes;
+    iov[1].iov_len = (m_numElements - firstLength) * sizeof(T);
+
+    const ssize_t n {::writev(fd, iov, (0 == iov[1].iov_len) ? 1 : 2)};
+    if ( n < 0 )
+    {
+      return std::make_tuple(cbBase::cbStatus::UNKNOWN, n);
+    }
+
+    const size_t transferred {m_drainOffset + static_cast<size_t>(n)};
+    const size_t numItems {transferred / sizeof(T)};
+    for (size_t i {0}; i < numItems; ++i)
+    {
+      m_pData.get()[m_readIndex] = m_noItem;
+      m_readIndex = (m_readIndex + 1) % m_cbSize;
+    }
+    m_numElements -= numItems;
+    m_headSequence += numItems;
+    m_drainOffset = transferred % sizeof(T);
+    _updateWatermarks();
+
+    const unsigned long numElements {m_numElements};
+    ul.unlock();
+    _notifyWatermarks(numElements);
+
+    return std::make_tuple(cbBase::cbStatus::REMOVED, n);
+  }
+
+  // read items from the file descriptor into the free space of the circular
+  // buffer with one readv() on (at most) two segments of the data, no
+  // intermediate copy; 0 bytes transferred means end of file.
+  // Only the items read completely are added; the bytes of a partially read item
+  // are kept and completed by the next call, so add() must not be called in
+  // between.
+  // The lock is held during the system call: a blocking fd that is not ready
+  // stalls all the producers and consumers, so prefer a non-blocking fd
+  cbioret
+  fillFrom(const int fd) const noexcept
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "expected trivially copyable types");
+
+    std::unique_lock<std::mutex> ul(m_mx);
+
+    if ( _isFull() )
+    {
+      return std::make_tuple(cbBase::cbStatus::FULL, 0);
+    }
+
+    auto* pBytes {reinterpret_cast<std::byte*>(m_pData.get())};
+    const unsigned long tail {(m_readIndex + m_numElements) % m_cbSize};
+    const unsigned long numFree {m_cbSize - m_numElements};
+    const unsigned long firstLength {std::min(numFree, m_cbSize - tail)};
+    iovec iov[2] {};
+    iov[0].iov_base = pBytes + tail * sizeof(T) + m_fillOffset;
+    iov[0].iov_len = firstLength * sizeof(T) - m_fillOffset;
+    iov[1].iov_base = pBytes;
+    iov[1].iov_len = (numFree - firstLength) * sizeof(T);
+
+    const ssize_t n {::readv(fd, iov, (0 == iov[1].iov_len) ? 1 : 2)};
+    if ( n < 0 )
+    {
+      return std::make_tuple(cbBase::cbStatus::UNKNOWN, n);
+    }
+
+    const size_t transferred {m_fillOffset + static_cast<size_t>(n)};
+    m_numElements += transferred / sizeof(T);
+    m_fillOffset = transferred % sizeof(T);
+    _updateWatermarks();
+
+    const unsigned long numElements {m_numElements};
+    ul.unlock();
+    _notifyWatermarks(numElements);
+
+    return std::make_tuple(cbBase::cbStatus::ADDED, n);
+  }
 };  // class cb
 }  // namespace circular_buffer
 
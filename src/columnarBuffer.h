@@ -0,0 +1,154 @@
+/*
+ * File:   columnarBuffer.h
+ */
+#pragma once
+
+#include "circularBuffer.h"
+#include <algorithm>
+#include <span>
+#include <utility>
+////////////////////////////////////////////////////////////////////////////////
+namespace circular_buffer
+{
+// Struct-of-arrays circular buffer: a row is a tuple of field types, each field
+// is stored in its own contiguous column; all the columns share the same head
+// and number of elements inherited from cbBase
+template <typename... Ts>
+class cbColumnar final : public cbBase
+{
+  static_assert(sizeof...(Ts) > 0, "at least one column type is needed");
+
+ public:
+  using row_t = std::tuple<Ts...>;
+
+  template <size_t I>
+  using column_t = std::tuple_element_t<I, row_t>;
+
+  // the live range of a column: it wraps around the end of the storage at most
+  // once, so it is made of at most two contiguous spans; the second span is
+  // empty when the live range does not wrap
+  template <size_t I>
+  using cbcolret = std::tuple<std::span<const column_t<I>>, std::span<const column_t<I>>>;
+
+ private:
+  using cbremret = std::tuple<cbBase::cbStatus, row_t, size_t>;
+  using indexes_t = std::index_sequence_for<Ts...>;
+
+  constexpr static inline row_t m_noItem {};
+
+  // one array of each field type, each having size cbSize
+  std::tuple<std::unique_ptr<Ts[]>...> m_pColumns {};
+
+  template <size_t... Is>
+  void
+  _set(const unsigned long i, const row_t& row, std::index_sequence<Is...>) const noexcept
+  {
+    ((std::get<Is>(m_pColumns).get()[i] = std::get<Is>(row)), ...);
+  }
+
+  template <size_t... Is>
+  row_t
+  _get(const unsigned long i, std::index_sequence<Is...>) const noexcept
+  {
+    return row_t {std::get<Is>(m_pColumns).get()[i]...};
+  }
+
+ public:
+  // we don't want these objects allocated on the heap
+  void* operator new(std::size_t) = delete;
+  void* operator new[](std::size_t) = delete;
+
+  void operator delete(void*) = delete;
+  void operator delete[](void*) = delete;
+
+  // delegating ctor: default ctor builds a circular buffer with the default size
+  cbColumnar() : cbColumnar(m_defaultSize) {}
+
+  cbColumnar(const cbColumnar&) = delete;
+  cbColumnar& operator= (const cbColumnar&) = delete;
+  cbColumnar(const cbColumnar&&) = delete;
+  cbColumnar& operator= (const cbColumnar&&) = delete;
+
+  explicit
+  cbColumnar(const unsigned long cbSize)
+  :
+  cbBase(cbSize),
+  // allocate one array of cbSize elements per column
+  m_pColumns (std::make_unique<Ts[]>(cbSize)...)
+  {}
+
+  // add a row in the circular buffer, if not full
+  cbaddret
+  add(const Ts&... items) const noexcept
+  {
+    std::unique_lock<std::mutex> ul(m_mx);
+
+    if ( _isFull() )
+    {
+      return std::make_tuple(cbBase::cbStatus::FULL, m_cbSize);
+    }
+
+    _set((m_readIndex + m_numElements) % m_cbSize,
+         std::forward_as_tuple(items...),
+         indexes_t {});
+
+    const unsigned long numElements {++m_numElements};
+    _updateWatermarks();
+    ul.unlock();
+    _notifyWatermarks(numElements);
+
+    return std::make_tuple(cbBase::cbStatus::ADDED, numElements);
+  }
+
+  // return the first row in the circular buffer, no changes in it
+  row_t
+  getFront() const noexcept
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    return _get(m_readIndex, indexes_t {});
+  }
+
+  // remove the first row from the circular buffer, if not empty
+  cbremret
+  remove() const noexcept
+  {
+    std::unique_lock<std::mutex> ul(m_mx);
+
+    if ( _isEmpty() )
+    {
+      return std::make_tuple(cbBase::cbStatus::EMPTY, m_noItem, 0);
+    }
+
+    auto t = std::make_tuple(cbBase::cbStatus::REMOVED,
+                             _get(m_readIndex, indexes_t {}),
+                             --m_numElements);
+
+    _set(m_readIndex, m_noItem, indexes_t {});
+    m_readIndex = (m_readIndex + 1) % m_cbSize;
+    _updateWatermarks();
+
+    ul.unlock();
+    _notifyWatermarks(std::get<2>(t));
+
+    return t;
+  }
+
+  // return the live range of column I as (at most) two contiguous spans, oldest
+  // elements first.
+  // The spans are views on the storage: they stay valid as long as no row they
+  // cover is removed, so the caller must not run this concurrently with remove()
+  template <size_t I>
+  cbcolret<I>
+  getColumn() const noexcept
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    const column_t<I>* pColumn {std::get<I>(m_pColumns).get()};
+    const unsigned long firstLength {std::min(m_numElements, m_cbSize - m_readIndex)};
+
+    return std::make_tuple(std::span<const column_t<I>>(pColumn + m_readIndex, firstLength),
+                           std::span<const column_t<I>>(pColumn, m_numElements - firstLength));
+  }
+};  // class cbColumnar
+}  // namespace circular_buffer
@@ -0,0 +1,259 @@
+/*
+ * File:   compressedBuffer.h
+ */
+#pragma once
+
+#include "circularBuffer.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+////////////////////////////////////////////////////////////////////////////////
+namespace circular_buffer
+{
+// Circular buffer of compressed integers for time series (counters,
+// timestamps, ...) that change by small deltas.
+// Values are stored in a ring of fixed-size blocks: the first value of a block
+// is kept raw in the block header, every following value is stored as the
+// zig-zag varint of its delta from the previous one.
+// When all the blocks are in use, adding a value that does not fit in the last
+// block evicts the oldest block: eviction from the head is block-granular
+template <typename T = uint64_t>
+class cbCompressed final
+{
+  static_assert(std::is_integral<T>::value, "expected integral types");
+
+  using U = std::make_unsigned_t<T>;
+  using S = std::make_signed_t<T>;
+  using cbaddret = std::tuple<cbBase::cbStatus, size_t>;
+  using cbremret = std::tuple<cbBase::cbStatus, size_t>;
+
+  struct blockHeader
+  {
+    T m_first {};
+    T m_last {};
+    uint32_t m_numValues {0};
+    uint32_t m_numBytes {0};
+  };
+
+  // the max number of bytes taken by the varint of a U
+  constexpr static inline size_t m_maxVarintBytes {(std::numeric_limits<U>::digits + 6) / 7};
+
+  const size_t m_numBlocks {};
+  const size_t m_blockBytes {};
+  std::unique_ptr<uint8_t[]> m_pData {};
+  std::unique_ptr<blockHeader[]> m_pBlocks {};
+
+  mutable std::mutex m_mx {};
+  mutable size_t m_headBlock {0};
+  mutable size_t m_numUsedBlocks {0};
+  mutable size_t m_numValues {0};
+
+  constexpr
+  static
+  U
+  _zigzag(const T value, const T previous) noexcept
+  {
+    // the delta is computed modulo 2^digits and then read as a signed value so
+    // that wrapping counters still give small deltas
+    const U delta {static_cast<U>(static_cast<U>(value) - static_cast<U>(previous))};
+    const S sdelta {static_cast<S>(delta)};
+
+    return static_cast<U>(static_cast<U>(delta << 1) ^
+                          static_cast<U>(sdelta >> (std::numeric_limits<U>::digits - 1)));
+  }
+
+  constexpr
+  static
+  T
+  _unzigzag(const U zz, const T previous) noexcept
+  {
+    const U delta {static_cast<U>((zz >> 1) ^ static_cast<U>(-static_cast<U>(zz & 1)))};
+
+    return static_cast<T>(static_cast<U>(static_cast<U>(previous) + delta));
+  }
+
+  void
+  _evictHeadBlock() const noexcept
+  {
+    m_numValues -= m_pBlocks.get()[m_headBlock].m_numValues;
+    m_pBlocks.get()[m_headBlock] = blockHeader {};
+    m_headBlock = (m_headBlock + 1) % m_numBlocks;
+    --m_numUsedBlocks;
+  }
+
+  void
+  _openBlock(const T item) const noexcept
+  {
+    if ( m_numBlocks == m_numUsedBlocks )
+    {
+      _evictHeadBlock();
+    }
+
+    m_pBlocks.get()[(m_headBlock + m_numUsedBlocks) % m_numBlocks] = blockHeader {item, item, 1, 0};
+    ++m_numUsedBlocks;
+  }
+
+ public:
+  // we don't want these objects allocated on the heap
+  void* operator new(std::size_t) = delete;
+  void* operator new[](std::size_t) = delete;
+
+  void operator delete(void*) = delete;
+  void operator delete[](void*) = delete;
+
+  cbCompressed(const cbCompressed&) = delete;
+  cbCompressed& operator= (const cbCompressed&) = delete;
+  cbCompressed(const cbCompressed&&) = delete;
+  cbCompressed& operator= (const cbCompressed&&) = delete;
+
+  cbCompressed(const size_t numBlocks, const size_t blockBytes) noexcept(false)
+  :
+  m_numBlocks(numBlocks),
+  m_blockBytes(blockBytes)
+  {
+    if ( 0 == m_numBlocks )
+    {
+      throw std::invalid_argument("ERROR: The number of blocks of the circular buffer must not be zero");
+    }
+    if ( m_blockBytes < m_maxVarintBytes )
+    {
+      throw std::invalid_argument("ERROR: The block size of the circular buffer is too small");
+    }
+    m_pData = std::make_unique<uint8_t[]>(m_numBlocks * m_blockBytes);
+    m_pBlocks = std::make_unique<blockHeader[]>(m_numBlocks);
+  }
+
+  // add an item in the circular buffer; it never fails: when needed the oldest
+  // block is evicted.
+  // Return the status and the number of values in the buffer after the action
+  cbaddret
+  add(const T& item) const noexcept
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    if ( 0 == m_numUsedBlocks )
+    {
+      _openBlock(item);
+      return std::make_tuple(cbBase::cbStatus::ADDED, ++m_numValues);
+    }
+
+    const size_t tailBlock {(m_headBlock + m_numUsedBlocks - 1) % m_numBlocks};
+    blockHeader& tail {m_pBlocks.get()[tailBlock]};
+
+    uint8_t varint[m_maxVarintBytes] {};
+    size_t length {0};
+    for (U zz {_zigzag(item, tail.m_last)}; ; zz = static_cast<U>(zz >> 7))
+    {
+      if ( zz < 0x80 )
+      {
+        varint[length++] = static_cast<uint8_t>(zz);
+        break;
+      }
+      varint[length++] = static_cast<uint8_t>((zz & 0x7f) | 0x80);
+    }
+
+    if ( tail.m_numBytes + length > m_blockBytes )
+    {
+      _openBlock(item);
+      return std::make_tuple(cbBase::cbStatus::ADDED, ++m_numValues);
+    }
+
+    std::copy(varint, varint + length, m_pData.get() + tailBlock * m_blockBytes + tail.m_numBytes);
+    tail.m_numBytes += static_cast<uint32_t>(length);
+    tail.m_last = item;
+    ++tail.m_numValues;
+
+    return std::make_tuple(cbBase::cbStatus::ADDED, ++m_numValues);
+  }
+
+  // remove the oldest block from the circular buffer, if not empty.
+  // Return the status and the number of values in the buffer after the action
+  cbremret
+  removeBlock() const noexcept
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    if ( 0 == m_numUsedBlocks )
+    {
+      return std::make_tuple(cbBase::cbStatus::EMPTY, 0);
+    }
+
+    _evictHeadBlock();
+
+    return std::make_tuple(cbBase::cbStatus::REMOVED, m_numValues);
+  }
+
+  // decode all the values in the circular buffer, oldest first, calling f(value)
+  // for each of them; the buffer is locked during the whole decoding
+  template <typename F>
+  void
+  forEach(F&& f) const
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    for (size_t b {0}; b < m_numUsedBlocks; ++b)
+    {
+      const size_t block {(m_headBlock + b) % m_numBlocks};
+      const blockHeader& header {m_pBlocks.get()[block]};
+      const uint8_t* p {m_pData.get() + block * m_blockBytes};
+      T value {header.m_first};
+
+      f(value);
+      for (uint32_t i {1}; i < header.m_numValues; ++i)
+      {
+        U zz {0};
+        for (unsigned int shift {0}; ; shift += 7)
+        {
+          const uint8_t byte {*p++};
+          zz = static_cast<U>(zz | (static_cast<U>(byte & 0x7f) << shift));
+          if ( 0 == (byte & 0x80) )
+          {
+            break;
+          }
+        }
+        value = _unzigzag(zz, value);
+        f(value);
+      }
+    }
+  }
+
+  size_t
+  getNumValues() const noexcept
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    return m_numValues;
+  }
+
+  size_t
+  getNumBlocks() const noexcept
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    return m_numUsedBlocks;
+  }
+
+  bool
+  isEmpty() const noexcept
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    return (0 == m_numValues);
+  }
+
+  constexpr
+  size_t
+  size() const noexcept
+  {
+    return m_numBlocks;
+  }
+
+  constexpr
+  size_t
+  blockSize() const noexcept
+  {
+    return m_blockBytes;
+  }
+};  // class cbCompressed
+}  // namespace circular_buffer
@@ -0,0 +1,195 @@
+/*
+ * File:   conflatingBuffer.h
+ */
+#pragma once
+
+#include "circularBuffer.h"
+#include <bit>
+#include <functional>
+#include <type_traits>
+////////////////////////////////////////////////////////////////////////////////
+namespace circular_buffer
+{
+// Conflating circular buffer: it holds at most one pending item per key, the
+// key of an item being given by KeyExtractor.
+// Adding an item whose key is already pending overwrites the pending item in
+// place, keeping its position: items are delivered in order of first arrival
+// of their key, each one with the latest value added for the key. A slow
+// consumer then has at most one pending item per distinct key, whatever the
+// rate of the updates.
+// The pending keys are indexed by an open-addressing hash table with linear
+// probing and backward-shift deletion, allocated at construction with at least
+// twice as many entries as the circular buffer
+template <typename T,
+          typename KeyExtractor,
+          typename Hash = std::hash<std::decay_t<std::invoke_result_t<const KeyExtractor&, const T&>>>>
+class cbConflating final : public cbBase
+{
+ public:
+  using key_t = std::decay_t<std::invoke_result_t<const KeyExtractor&, const T&>>;
+
+ private:
+  using cbremret = std::tuple<cbBase::cbStatus, T, size_t>;
+
+  constexpr static inline T m_noItem {};
+
+  struct entry
+  {
+    key_t m_key {};
+    // index of the pending item in m_pData
+    unsigned long m_index {0};
+    bool m_used {false};
+  };
+
+  const KeyExtractor m_keyOf {};
+  const Hash m_hash {};
+  const size_t m_tableMask {};
+  std::unique_ptr<T[]> m_pData {};
+  std::unique_ptr<entry[]> m_pTable {};
+  mutable uint64_t m_numConflated {0};
+
+  size_t
+  _home(const key_t& key) const noexcept
+  {
+    return m_hash(key) & m_tableMask;
+  }
+
+  // the table entry of the key, or of the first free slot where to insert it
+  size_t
+  _find(const key_t& key) const noexcept
+  {
+    size_t i {_home(key)};
+
+    while ( m_pTable[i].m_used && !(m_pTable[i].m_key == key) )
+    {
+      i = (i + 1) & m_tableMask;
+    }
+    return i;
+  }
+
+  // empty the entry and shift back the following entries of its probe chain,
+  // so that lookups never need tombstones
+  void
+  _erase(size_t i) const noexcept
+  {
+    size_t j {i};
+
+    while ( true )
+    {
+      j = (j + 1) & m_tableMask;
+      if ( !m_pTable[j].m_used )
+      {
+        break;
+      }
+      // entry j may fill the hole at i only if its home is not in (i, j]
+      const size_t k {_home(m_pTable[j].m_key)};
+      if ( ((i <= j) && ((k <= i) || (k > j))) ||
+           ((i > j) && ((k <= i) && (k > j))) )
+      {
+        m_pTable[i] = m_pTable[j];
+        i = j;
+      }
+    }
+    m_pTable[i] = entry {};
+  }
+
+ public:
+  // we don't want these objects allocated on the heap
+  void* operator new(std::size_t) = delete;
+  void* operator new[](std::size_t) = delete;
+
+  void operator delete(void*) = delete;
+  void operator delete[](void*) = delete;
+
+  cbConflating(const cbConflating&) = delete;
+  cbConflating& operator= (const cbConflating&) = delete;
+  cbConflating(const cbConflating&&) = delete;
+  cbConflating& operator= (const cbConflating&&) = delete;
+
+  // cbSize is the max number of distinct keys pending at the same time
+  explicit
+  cbConflating(const unsigned long cbSize,
+               const KeyExtractor& keyOf = KeyExtractor(),
+               const Hash& hash = Hash()) noexcept(false)
+  :
+  cbBase(cbSize),
+  m_keyOf(keyOf),
+  m_hash(hash),
+  m_tableMask(std::bit_ceil(2 * cbSize) - 1),
+  m_pData (std::make_unique<T[]>(cbSize)),
+  m_pTable (std::make_unique<entry[]>(m_tableMask + 1))
+  {}
+
+  // add an item in the circular buffer: CONFLATED when it replaced the pending
+  // item having the same key, ADDED when its key was not pending, FULL when its
+  // key was not pending and the circular buffer is full.
+  // Return the status and the number of items after the action
+  cbaddret
+  add(const T& item) const noexcept
+  {
+    const key_t key {m_keyOf(item)};
+    std::unique_lock<std::mutex> ul(m_mx);
+    const size_t i {_find(key)};
+
+    if ( m_pTable[i].m_used )
+    {
+      m_pData.get()[m_pTable[i].m_index] = item;
+      ++m_numConflated;
+      return std::make_tuple(cbBase::cbStatus::CONFLATED, m_numElements);
+    }
+    if ( _isFull() )
+    {
+      return std::make_tuple(cbBase::cbStatus::FULL, m_cbSize);
+    }
+
+    const unsigned long index {(m_readIndex + m_numElements) % m_cbSize};
+
+    m_pData.get()[index] = item;
+    m_pTable[i] = entry {key, index, true};
+
+    const unsigned long numElements {++m_numElements};
+    _updateWatermarks();
+    ul.unlock();
+    _notifyWatermarks(numElements);
+
+    return std::make_tuple(cbBase::cbStatus::ADDED, numElements);
+  }
+
+  // remove the first item from the circular buffer, if not empty
+  cbremret
+  remove() const noexcept
+  {
+    std::unique_lock<std::mutex> ul(m_mx);
+
+    if ( _isEmpty() )
+    {
+      return std::make_tuple(cbBase::cbStatus::EMPTY, m_noItem, 0);
+    }
+
+    const T& front {m_pData.get()[m_readIndex]};
+
+    _erase(_find(m_keyOf(front)));
+
+    auto t = std::make_tuple(cbBase::cbStatus::REMOVED, front, --m_numElements);
+
+    m_pData.get()[m_readIndex] = m_noItem;
+    m_readIndex = (m_readIndex + 1) % m_cbSize;
+    _updateWatermarks();
+
+    ul.unlock();
+    _notifyWatermarks(std::get<2>(t));
+
+    return t;
+  }
+
+  // number of items overwritten by a later item with the same key since
+  // construction
+  uint64_t
+  getNumConflated() const noexcept
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    return m_numConflated;
+  }
+};  // class cbConflating
+}  // namespace circular_buffer
@@ -2,6 +2,14 @@
  * File:   circular-buffer-example.cpp
  */
 #include "../circularBuffer.h"
+#include "../threadAffinity.h"
+#ifdef DO_LOGS
+#include "../binaryLogger.h"
+#endif
+#ifdef DO_PERF_COUNTERS
+#include "../perfCounters.h"
+#endif
+#include <atomic>
 #include <future>
 #include <sstream>
 #include <chrono>
@@ -49,6 +57,15 @@ struct pclog : public std::stringstream
   }
 };
 
+// logs of the producer and consumer loops: the hot threads only write the
+// format id and the arguments, the logger thread formats them
+using cbLogger = circular_buffer::cbLogger;
+
+static const uint32_t ITEM_LOG {cbLogger::registerFormat("[{}] {} - item: {} - num of elements: {}\n")};
+static const uint32_t ITEM_REMOVED_LOG {cbLogger::registerFormat("[{}] {} - item removed: {} - num of elements: {}\n")};
+static const uint32_t STATUS_LOG {cbLogger::registerFormat("[{}] {} - num of elements: {}\n")};
+static const uint32_t TERMINATED_LOG {cbLogger::registerFormat("[{}] TERMINATED\n")};
+
 static
 void
 printCBStatus(std::string&& callerFun,
@@ -105,13 +122,7 @@ producerExample(const cb_shptr_t& cb_shptr) -> cbtype
       case circular_buffer::cbBase::cbStatus::ADDED:
       {
 #ifdef DO_LOGS
-        pclog{} << "[" << __func__ << "] "
-                << cb_shptr->cbStatusString(cbS)
-                << " - item: "
-                << item
-                << " - num of elements: "
-                << numElements
-                << "\n";
+        cbLogger::log(ITEM_LOG, __func__, cb_shptr->cbStatusString(cbS).c_str(), item, numElements);
         previousCBS = cbS;
 #endif
         ++item;
@@ -124,22 +135,20 @@ producerExample(const cb_shptr_t& cb_shptr) -> cbtype
 #ifdef DO_LOGS
         if ( cbS != previousCBS )
         {
-          pclog{} << "[" << __func__ << "] "
-                  << cb_shptr->cbStatusString(cbS)
-                  << " - num of elements: "
-                  << numElements
-                  << "\n";
+          cbLogger::log(STATUS_LOG, __func__, cb_shptr->cbStatusString(cbS).c_str(), numElements);
           previousCBS = cbS;
         }
 #endif
         allow(3);
       }
       break;
+
+      default:
+      break;
     }
   }
 #ifdef DO_LOGS
-  pclog{} << "[" << __func__ << "] "
-          << "TERMINATED\n";
+  cbLogger::log(TERMINATED_LOG, __func__);
 #endif
   return (item - static_cast<cbtype>(1));
 }  // producerExample
@@ -155,7 +164,7 @@ consumerExample(const cb_shptr_t& cb_shptr) -> cbtype
   circular_buffer::cbBase::cbStatus cbS {circular_buffer::cbBase::cbStatus::UNKNOWN};
   cbtype item {0};
   size_t numElements {0};
-  
+
   while ( item != LIMIT )
   {
     // try to remove an item; get the result, the item, and the number of items
@@ -167,13 +176,7 @@ consumerExample(const cb_shptr_t& cb_shptr) -> cbtype
       case circular_buffer::cbBase::cbStatus::REMOVED:
       {
 #ifdef DO_LOGS
-        pclog{} << "[" << __func__ << "] "
-                << cb_shptr->cbStatusString(cbS)
-                << " - item removed: "
-                << item
-                << " - num of elements: "
-                << numElements
-                << "\n";
+        cbLogger::log(ITEM_REMOVED_LOG, __func__, cb_shptr->cbStatusString(cbS).c_str(), item, numElements);
         previousCBS = cbS;
 #endif
         allow(0);
@@ -185,22 +188,20 @@ consumerExample(const cb_shptr_t& cb_shptr) -> cbtype
 #ifdef DO_LOGS
         if ( cbS != previousCBS )
         {
-          pclog{} << "[" << __func__ << "] "
-                  << cb_shptr->cbStatusString(cbS)
-                  << " - num of elements: "
-                  << numElements
-                  << "\n";
+          cbLogger::log(STATUS_LOG, __func__, cb_shptr->cbStatusString(cbS).c_str(), numElements);
           previousCBS = cbS;
         }
 #endif
         allow(5);
       }
       break;
+
+      default:
+      break;
     }
   }
 #ifdef DO_LOGS
-  pclog{} << "[" << __func__ << "] "
-          << "TERMINATED\n";
+  cbLogger::log(TERMINATED_LOG, __func__);
 #endif
   return item;
 }  // consumerExample
@@ -219,6 +220,77 @@ producerThreadedExample(const cb_shptr_t& cb_shptr)
   producerExample(cb_shptr);
 }  // producerThreadedExample
 
+#ifdef DO_PERF_COUNTERS
+// producer and consumer adding and removing LIMIT items in tight loops, with no
+// logs and no sleeps: the counters of each thread are enabled once around its
+// loop and divided by its number of add()/remove() calls
+static
+void
+perfCountersExample() noexcept
+{
+  std::cout << "[" << __func__ << "] STARTING\n\n";
+
+  const cb_t aCircularBuffer(CBSIZE);
+  std::atomic<bool> go {false};
+
+  try
+  {
+    std::thread cthrd([&aCircularBuffer, &go] ()
+                      {
+                        circular_buffer::perfCounters counters {};
+                        uint64_t numOps {0};
+
+                        while ( !go.load(std::memory_order_acquire) ) { std::this_thread::yield(); }
+                        counters.start();
+                        for (cbtype removed {0}; removed < LIMIT; ++numOps)
+                        {
+                          if ( circular_buffer::cbBase::cbStatus::REMOVED ==
+                               std::get<0>(aCircularBuffer.remove()) )
+                          {
+                            ++removed;
+                          }
+                        }
+                        counters.stop();
+                        counters.print("consumer", numOps);
+                      });
+
+    std::thread pthrd([&aCircularBuffer, &go] ()
+                      {
+                        circular_buffer::perfCounters counters {};
+                        uint64_t numOps {0};
+
+                        while ( !go.load(std::memory_order_acquire) ) { std::this_thread::yield(); }
+                        counters.start();
+                        for (cbtype item {0}; item < LIMIT; ++numOps)
+                        {
+                          if ( circular_buffer::cbBase::cbStatus::ADDED ==
+                               std::get<0>(aCircularBuffer.add(item)) )
+                          {
+                            ++item;
+                          }
+                        }
+                        counters.stop();
+                        counters.print("producer", numOps);
+                      });
+
+    go.store(true, std::memory_order_release);
+    cthrd.join();
+    pthrd.join();
+  }
+  catch( const std::exception& e )
+  {
+#ifdef DO_LOGS
+    pclog{} << "EXCEPTION: "
+            << e.what()
+            << "\n";
+#endif
+  }
+
+  std::cout << "\n[" << __func__ << "] "
+            << "TERMINATED\n";
+}  // perfCountersExample
+#endif
+
 static
 void
 taskExample () noexcept
@@ -250,6 +322,7 @@ taskExample () noexcept
     auto pr = pf.get();
     auto cr = cf.get();
 #ifdef DO_LOGS
+    cbLogger::flush();
     pclog{} << "[" << __func__ << "] "
             << "producer result: " << pr << "\n";
     pclog{} << "[" << __func__ << "] "
@@ -304,13 +377,7 @@ threadedExample() noexcept
   try
   {
     std::thread cthrd(consumerThreadedExample, aCircularBuffer_sp);
-    // Create a cpu_set_t object representing a set of CPUs.
-    // Clear it and mark only a CPU as set.
-    cpu_set_t consumer_cpuset;
-    CPU_ZERO(&consumer_cpuset);
-    CPU_SET(consumerCPU, &consumer_cpuset);
-    int crc {pthread_setaffinity_np(cthrd.native_handle(),
-                                    sizeof(cpu_set_t), &consumer_cpuset)};
+    int crc {circular_buffer::pinThread(cthrd.native_handle(), static_cast<unsigned int>(consumerCPU))};
     if ( 0 != crc )
     {
 #ifdef DO_LOGS
@@ -319,13 +386,7 @@ threadedExample() noexcept
     }
 
     std::thread pthrd(producerThreadedExample, aCircularBuffer_sp);
-    // Create a cpu_set_t object representing a set of CPUs.
-    // Clear it and mark only a CPU as set.
-    cpu_set_t producer_cpuset;
-    CPU_ZERO(&producer_cpuset);
-    CPU_SET(producerCPU, &producer_cpuset);
-    int prc {pthread_setaffinity_np(pthrd.native_handle(),
-                                    sizeof(cpu_set_t), &producer_cpuset)};
+    int prc {circular_buffer::pinThread(pthrd.native_handle(), static_cast<unsigned int>(producerCPU))};
     if ( 0 != prc )
     {
 #ifdef DO_LOGS
@@ -335,6 +396,9 @@ threadedExample() noexcept
 
     cthrd.join();
     pthrd.join();
+#ifdef DO_LOGS
+    cbLogger::flush();
+#endif
   }
   catch( const std::exception& e )
   {
@@ -363,6 +427,12 @@ main() -> int
 {
   std::cout << "\n[" << __func__ << "] STARTING\n";
 
+#ifdef DO_LOGS
+  // same stream as pclog, written under the same mutex, so that lines from
+  // both never mix
+  const cbLogger logger(std::clog, 4'096, std::chrono::microseconds(1'000), &pclog::cout_mutex);
+#endif
+
   // this example only deals with integral or floating points types
   static_assert( (   (false == std::is_floating_point<cbtype>::value)
                   || (false == std::is_integral<cbtype>::value)),
@@ -381,6 +451,12 @@ main() -> int
 
   taskExample();
 
+#ifdef DO_PERF_COUNTERS
+  std::cout << "\n------------------------------------\n\n";
+
+  perfCountersExample();
+
+#endif
   std::cout << "\n[" << __func__ << "] "
             << "TERMINATED\n\n";
 }  // main
@@ -0,0 +1,427 @@
+/*
+ * File:   executor.h
+ */
+#pragma once
+
+#include "circularBuffer.h"
+#include "threadAffinity.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <variant>
+#include <vector>
+////////////////////////////////////////////////////////////////////////////////
+namespace circular_buffer
+{
+// A callable stored inline, without heap allocations: callables larger than
+// m_capacity bytes are rejected at compile time.
+// It is a literal type so that it can be stored in a cb
+class cbTask final
+{
+ public:
+  constexpr static inline size_t m_capacity {64 - sizeof(void*)};
+
+ private:
+  struct ops
+  {
+    void (*m_invoke)(void*);
+    void (*m_copy)(void*, const void*);
+    void (*m_destroy)(void*);
+  };
+
+  template <typename F>
+  constexpr static inline ops m_opsFor
+  {
+    [] (void* p) { (*static_cast<F*>(p))(); },
+    [] (void* dst, const void* src) { ::new (dst) F(*static_cast<const F*>(src)); },
+    [] (void* p) { static_cast<F*>(p)->~F(); }
+  };
+
+  alignas(std::max_align_t) std::byte m_storage[m_capacity] {};
+  const ops* m_pOps {nullptr};
+
+  constexpr
+  void
+  _reset() noexcept
+  {
+    if ( nullptr != m_pOps )
+    {
+      m_pOps->m_destroy(m_storage);
+      m_pOps = nullptr;
+    }
+  }
+
+ public:
+  constexpr cbTask() noexcept = default;
+
+  template <typename F,
+            typename D = std::decay_t<F>,
+            typename = std::enable_if_t<!std::is_same<D, cbTask>::value>>
+  explicit
+  cbTask(F&& f) noexcept(std::is_nothrow_constructible<D, F>::value)
+  {
+    static_assert(sizeof(D) <= m_capacity, "callable too large for a cbTask");
+    static_assert(alignof(D) <= alignof(std::max_align_t), "callable over-aligned for a cbTask");
+
+    ::new (static_cast<void*>(m_storage)) D(std::forward<F>(f));
+    m_pOps = &m_opsFor<D>;
+  }
+
+  cbTask(const cbTask& rhs)
+  :
+  m_pOps(rhs.m_pOps)
+  {
+    if ( nullptr != m_pOps )
+    {
+      m_pOps->m_copy(m_storage, rhs.m_storage);
+    }
+  }
+
+  cbTask&
+  operator= (const cbTask& rhs)
+  {
+    if ( this != &rhs )
+    {
+      _reset();
+      if ( nullptr != rhs.m_pOps )
+      {
+        rhs.m_pOps->m_copy(m_storage, rhs.m_storage);
+      }
+      m_pOps = rhs.m_pOps;
+    }
+    return *this;
+  }
+
+  constexpr
+  ~cbTask()
+  {
+    _reset();
+  }
+
+  explicit
+  operator bool() const noexcept
+  {
+    return (nullptr != m_pOps);
+  }
+
+  void
+  operator()()
+  {
+    m_pOps->m_invoke(m_storage);
+  }
+};  // class cbTask
+
+class cbExecutor;
+
+// Result of a task submitted to a cbExecutor.
+// The task writes the result directly in the future, so the future can be
+// neither copied nor moved, and its destructor waits for the task to be done.
+// The task publishes the result under the mutex: its unlock is the last access
+// of the worker to the future, and waiting takes the mutex, so the future can
+// be destroyed as soon as wait() returns
+template <typename R>
+class cbFuture final
+{
+  friend class cbExecutor;
+
+  using value_t = std::conditional_t<std::is_void<R>::value, std::monostate, R>;
+
+  mutable std::mutex m_mx {};
+  mutable std::condition_variable m_cv {};
+  // also read without the mutex by isReady()
+  std::atomic<bool> m_ready {false};
+  std::optional<value_t> m_value {};
+  std::exception_ptr m_exception {};
+
+  template <typename F>
+  cbFuture(const cbExecutor& executor, F&& f);
+
+  template <typename F>
+  void
+  _run(F& f) noexcept
+  {
+    try
+    {
+      if constexpr ( std::is_void<R>::value )
+      {
+        f();
+        m_value.emplace();
+      }
+      else
+      {
+        m_value.emplace(f());
+      }
+    }
+    catch ( ... )
+    {
+      m_exception = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    m_ready.store(true, std::memory_order_release);
+    m_cv.notify_all();
+  }
+
+ public:
+  cbFuture(const cbFuture&) = delete;
+  cbFuture& operator= (const cbFuture&) = delete;
+  cbFuture(const cbFuture&&) = delete;
+  cbFuture& operator= (const cbFuture&&) = delete;
+
+  ~cbFuture()
+  {
+    wait();
+  }
+
+  bool
+  isReady() const noexcept
+  {
+    return m_ready.load(std::memory_order_acquire);
+  }
+
+  void
+  wait() const noexcept
+  {
+    std::unique_lock<std::mutex> ul(m_mx);
+
+    m_cv.wait(ul, [this] () { return m_ready.load(std::memory_order_relaxed); });
+  }
+
+  // wait for the task and return its result; rethrow the exception thrown by
+  // the task, if any
+  R
+  get()
+  {
+    wait();
+    if ( m_exception )
+    {
+      std::rethrow_exception(m_exception);
+    }
+    if constexpr ( !std::is_void<R>::value )
+    {
+      return std::move(*m_value);
+    }
+  }
+};  // class cbFuture
+
+// Fixed pool of worker threads, each one pinned on a cpu and having its own
+// circular buffer of tasks, all allocated at construction.
+// Tasks are distributed round robin; an idle worker steals tasks from the
+// buffers of the other workers when work stealing is enabled.
+// Submitting a task allocates nothing: the callable is stored inline in the
+// buffer and the future lives in the caller.
+// A task submitted by a worker of the executor while all the buffers are full
+// runs inline on that worker: waiting for room could deadlock, since the
+// waiting worker may be the one that would make room.
+// The workers terminate only when no task is queued or running, so that tasks
+// posted by other tasks during the destruction run too
+class cbExecutor final
+{
+  template <typename R>
+  friend class cbFuture;
+
+  using cb_shptr_t = std::shared_ptr<cb<cbTask>>;
+
+  // the executor the calling thread is a worker of, if any
+  static inline thread_local const cbExecutor* m_pCurrentExecutor {nullptr};
+
+  const bool m_workStealing {true};
+  std::vector<cb_shptr_t> m_queues {};
+  std::vector<std::thread> m_workers {};
+  std::atomic<bool> m_stopped {false};
+  mutable std::atomic<size_t> m_nextQueue {0};
+  // tasks queued or running; a task posting another one counts until the new
+  // one is queued
+  mutable std::atomic<size_t> m_numPending {0};
+
+  static
+  void
+  _allow(const int64_t d = 0) noexcept
+  {
+    std::this_thread::yield();
+    if ( 0 == d )
+    {
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::nanoseconds(d));
+  }
+
+  bool
+  _runTask(const cb_shptr_t& queue) const
+  {
+    auto [cbS, task, numElements] = queue->remove();
+
+    if ( cbBase::cbStatus::REMOVED != cbS )
+    {
+      return false;
+    }
+    try
+    {
+      task();
+    }
+    catch ( ... )
+    {
+      // a posted task has nobody to report to; submitted tasks catch their
+      // exceptions themselves and give them to their future
+    }
+    m_numPending.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+  }
+
+  // add a task to the next worker buffer with room for it; wait while all the
+  // buffers are full, or run the task inline when called by a worker
+  void
+  _post(const cbTask& task) const
+  {
+    m_numPending.fetch_add(1, std::memory_order_acq_rel);
+    while ( true )
+    {
+      const size_t first {m_nextQueue.fetch_add(1, std::memory_order_relaxed)};
+
+      for (size_t j {0}; j < m_queues.size(); ++j)
+      {
+        if ( cbBase::cbStatus::ADDED == std::get<0>(m_queues[(first + j) % m_queues.size()]->add(task)) )
+        {
+          return;
+        }
+      }
+      if ( this == m_pCurrentExecutor )
+      {
+        cbTask inlineTask(task);
+
+        // the calling task still counts, so the workers cannot terminate
+        m_numPending.fetch_sub(1, std::memory_order_acq_rel);
+        inlineTask();
+        return;
+      }
+      _allow();
+    }
+  }
+
+  void
+  _runWorker(const size_t i, const int cpu) noexcept
+  {
+    m_pCurrentExecutor = this;
+    if ( cpu >= 0 )
+    {
+      pinCurrentThread(static_cast<unsigned int>(cpu));
+    }
+
+    unsigned int idleRounds {0};
+    while ( true )
+    {
+      bool ran {_runTask(m_queues[i])};
+
+      for (size_t j {1}; !ran && m_workStealing && (j < m_queues.size()); ++j)
+      {
+        ran = _runTask(m_queues[(i + j) % m_queues.size()]);
+      }
+
+      if ( ran )
+      {
+        idleRounds = 0;
+        continue;
+      }
+      // terminate only when no task is queued or running anywhere: a running
+      // task may still post to this queue
+      if ( m_stopped.load(std::memory_order_acquire) &&
+           (0 == m_numPending.load(std::memory_order_acquire)) )
+      {
+        break;
+      }
+      // spin for a while, then back off
+      _allow((++idleRounds < 64) ? 0 : 10'000);
+    }
+  }
+
+ public:
+  cbExecutor(const cbExecutor&) = delete;
+  cbExecutor& operator= (const cbExecutor&) = delete;
+  cbExecutor(const cbExecutor&&) = delete;
+  cbExecutor& operator= (const cbExecutor&&) = delete;
+
+  // worker i is pinned on cpus[i] when given, on cpu i modulo the number of
+  // cores otherwise; a negative cpu leaves the worker unpinned
+  explicit
+  cbExecutor(const size_t numWorkers,
+             const unsigned long queueSize = 1'024,
+             const bool workStealing = true,
+             const std::vector<int>& cpus = {}) noexcept(false)
+  :
+  m_workStealing(workStealing)
+  {
+    if ( 0 == numWorkers )
+    {
+      throw std::invalid_argument("ERROR: The number of workers must not be zero");
+    }
+    if ( !cpus.empty() && (cpus.size() != numWorkers) )
+    {
+      throw std::invalid_argument("ERROR: One cpu per worker is needed");
+    }
+
+    const unsigned int numCPUs {std::max(1u, std::thread::hardware_concurrency())};
+    for (size_t i {0}; i < numWorkers; ++i)
+    {
+      m_queues.push_back(std::make_shared<cb<cbTask>>(queueSize));
+    }
+    for (size_t i {0}; i < numWorkers; ++i)
+    {
+      const int cpu {cpus.empty() ? static_cast<int>(i % numCPUs) : cpus[i]};
+      m_workers.emplace_back(&cbExecutor::_runWorker, this, i, cpu);
+    }
+  }
+
+  // run all the submitted tasks, including the ones they post or submit, then
+  // terminate the workers
+  ~cbExecutor()
+  {
+    m_stopped.store(true, std::memory_order_release);
+    for (auto& w : m_workers)
+    {
+      w.join();
+    }
+  }
+
+  // fire and forget: an exception thrown by the task is dropped, submit() it
+  // to get the exception
+  template <typename F>
+  void
+  post(F&& f) const
+  {
+    _post(cbTask(std::forward<F>(f)));
+  }
+
+  // run f on a worker; the returned future gets its result
+  template <typename F>
+  cbFuture<std::invoke_result_t<std::decay_t<F>&>>
+  submit(F&& f) const
+  {
+    // guaranteed copy elision: the future is built directly in the caller, so
+    // the task can keep its address
+    return cbFuture<std::invoke_result_t<std::decay_t<F>&>>(*this, std::forward<F>(f));
+  }
+
+  size_t
+  getNumWorkers() const noexcept
+  {
+    return m_workers.size();
+  }
+};  // class cbExecutor
+
+template <typename R>
+template <typename F>
+cbFuture<R>::cbFuture(const cbExecutor& executor, F&& f)
+{
+  executor._post(cbTask([this, fn = std::decay_t<F>(std::forward<F>(f))] () mutable
+                        {
+                          _run(fn);
+                        }));
+}
+}  // namespace circular_buffer
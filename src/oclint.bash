@@ -7,6 +7,7 @@
 clang-check -p ../build/ \
             ./*.cpp \
             ./example/*.cpp \
+            ./benchmark/*.cpp \
             ./unitTests/*.cpp \
             -- -std=c++20 -O0 -pthread -Wall -Wextra -pedantic -I. -lm
 #
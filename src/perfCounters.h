@@ -0,0 +1,234 @@
+/*
+ * File:   perfCounters.h
+ */
+#pragma once
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <array>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <tuple>
+////////////////////////////////////////////////////////////////////////////////
+namespace circular_buffer
+{
+// Hardware and software performance counters of the calling thread, read with
+// perf_event_open(2).
+// The counters are opened as one group, so that they are enabled, disabled and
+// read together with a single system call each, and count exactly the same
+// code. A counter not available on the machine, in a VM, because of
+// /proc/sys/kernel/perf_event_paranoid, or because the PMU cannot schedule it
+// with the others is reported as not available and the others still work.
+// Start and stop the counters once around a tight run of operations, then
+// divide by the number of operations: the system calls are not free, and
+// bracketing every single operation would measure them instead.
+// An object must be created, started, stopped, and read by the thread to be
+// measured
+class perfCounters final
+{
+ public:
+  enum class counter : uint8_t {CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES,
+                                BRANCH_MISSES, CONTEXT_SWITCHES, NUM_COUNTERS};
+
+ private:
+  constexpr static inline size_t m_numCounters {static_cast<size_t>(counter::NUM_COUNTERS)};
+  // position in the group of a counter not available
+  constexpr static inline size_t m_noPosition {m_numCounters};
+
+  struct counterConfig
+  {
+    const char* m_name;
+    uint32_t m_type;
+    uint64_t m_config;
+  };
+
+  constexpr static inline std::array<counterConfig, m_numCounters> m_configs
+  {{
+     {"cycles",           PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES}
+    ,{"instructions",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS}
+    ,{"L1D-misses",       PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                                              (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)}
+    ,{"LLC-misses",       PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES}
+    ,{"branch-misses",    PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}
+    ,{"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES}
+  }};
+
+  static inline std::mutex m_printMutex {};
+
+  // the first counter opened leads the group; -1 when none is available
+  int m_leaderFd {-1};
+  std::array<int, m_numCounters> m_fds {};
+  // position of the value of every counter in what the leader reads
+  std::array<size_t, m_numCounters> m_positions {};
+  size_t m_groupSize {0};
+
+  static
+  int
+  _open(const counterConfig& cfg, const bool excludeKernel, const int groupFd) noexcept
+  {
+    perf_event_attr attr {};
+    attr.size = sizeof(perf_event_attr);
+    attr.type = cfg.m_type;
+    attr.config = cfg.m_config;
+    // the members follow the leader
+    attr.disabled = (groupFd < 0) ? 1 : 0;
+    attr.exclude_kernel = excludeKernel ? 1 : 0;
+    attr.exclude_hv = 1;
+    // all the values in one read; the times are needed to scale the values
+    // when the group is multiplexed with other events
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // pid 0, cpu -1: the calling thread, on any cpu
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+  }
+
+  void
+  _ioctl(const unsigned long request) const noexcept
+  {
+    if ( m_leaderFd >= 0 )
+    {
+      ioctl(m_leaderFd, request, PERF_IOC_FLAG_GROUP);
+    }
+  }
+
+ public:
+  perfCounters(const perfCounters&) = delete;
+  perfCounters& operator= (const perfCounters&) = delete;
+  perfCounters(const perfCounters&&) = delete;
+  perfCounters& operator= (const perfCounters&&) = delete;
+
+  perfCounters() noexcept
+  {
+    for (size_t i {0}; i < m_numCounters; ++i)
+    {
+      // context switches are counted by the kernel: try to include it first,
+      // then fall back to user space only when not allowed
+      const bool isSoftware {PERF_TYPE_SOFTWARE == m_configs[i].m_type};
+      m_fds[i] = _open(m_configs[i], !isSoftware, m_leaderFd);
+      if ( (m_fds[i] < 0) && isSoftware )
+      {
+        m_fds[i] = _open(m_configs[i], true, m_leaderFd);
+      }
+
+      m_positions[i] = m_noPosition;
+      if ( m_fds[i] >= 0 )
+      {
+        if ( m_leaderFd < 0 )
+        {
+          m_leaderFd = m_fds[i];
+        }
+        m_positions[i] = m_groupSize++;
+      }
+    }
+  }
+
+  ~perfCounters()
+  {
+    // the members first, the leader last
+    for (size_t i {m_numCounters}; i > 0; --i)
+    {
+      if ( m_fds[i - 1] >= 0 )
+      {
+        close(m_fds[i - 1]);
+      }
+    }
+  }
+
+  // reset all the available counters, leaving them disabled or enabled as
+  // they are
+  void
+  reset() const noexcept
+  {
+    _ioctl(PERF_EVENT_IOC_RESET);
+  }
+
+  // enable all the available counters, keeping their values
+  void
+  resume() const noexcept
+  {
+    _ioctl(PERF_EVENT_IOC_ENABLE);
+  }
+
+  // reset and enable all the available counters
+  void
+  start() const noexcept
+  {
+    reset();
+    resume();
+  }
+
+  void
+  stop() const noexcept
+  {
+    _ioctl(PERF_EVENT_IOC_DISABLE);
+  }
+
+  bool
+  isAvailable(const counter c) const noexcept
+  {
+    return (m_fds[static_cast<size_t>(c)] >= 0);
+  }
+
+  // return whether the counter is available and its value, scaled when the
+  // group was multiplexed with other events
+  std::tuple<bool, uint64_t>
+  read(const counter c) const noexcept
+  {
+    const size_t position {m_positions[static_cast<size_t>(c)]};
+    // number of values, time enabled, time running, values
+    uint64_t values[3 + m_numCounters] {};
+    const ssize_t size {static_cast<ssize_t>((3 + m_groupSize) * sizeof(uint64_t))};
+
+    if ( (m_noPosition == position) ||
+         (size != ::read(m_leaderFd, values, static_cast<size_t>(size))) ||
+         (0 == values[2]) )
+    {
+      return std::make_tuple(false, 0);
+    }
+
+    uint64_t value {values[3 + position]};
+    if ( values[1] != values[2] )
+    {
+      value = static_cast<uint64_t>(static_cast<double>(value) * values[1] / values[2]);
+    }
+    return std::make_tuple(true, value);
+  }
+
+  // print all the counters divided by the number of operations done while
+  // they were enabled; not available counters are printed as n/a
+  void
+  print(const std::string& caller, const uint64_t numOps) const noexcept(false)
+  {
+    std::ostringstream os {};
+
+    os << "[" << caller << "] "
+       << "perf counters per operation (" << numOps << " operations):";
+    for (size_t i {0}; i < m_numCounters; ++i)
+    {
+      auto [available, value] = read(static_cast<counter>(i));
+
+      os << " " << m_configs[i].m_name << ": ";
+      if ( available && (numOps > 0) )
+      {
+        os << std::fixed << std::setprecision(3)
+           << static_cast<double>(value) / static_cast<double>(numOps);
+      }
+      else
+      {
+        os << "n/a";
+      }
+    }
+    os << "\n";
+
+    std::lock_guard<std::mutex> lg(m_printMutex);
+    std::cout << os.str();
+  }
+};  // class perfCounters
+}  // namespace circular_buffer
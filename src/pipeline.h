@@ -0,0 +1,313 @@
+/*
+ * File:   pipeline.h
+ */
+#pragma once
+
+#include "circularBuffer.h"
+#include "threadAffinity.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <span>
+#include <thread>
+#include <vector>
+////////////////////////////////////////////////////////////////////////////////
+namespace circular_buffer
+{
+// Pipeline of stages connected by circular buffers: stage i removes batches of
+// items from buffer i, transforms them, and adds the results to buffer i + 1.
+// Every stage runs on its own thread, optionally pinned on a cpu.
+// Usage:
+//   cbPipeline<T> p(queueSize);
+//   p.addStage(f1, cpu1).addStage(f2, cpu2);
+//   p.start();
+//   p.push(...); ... p.pop(); ...
+//   p.close();   // no more input: stages drain their buffers and terminate
+//   p.join();
+// A stage throwing an exception stops the whole pipeline: the items still in
+// the buffers are not processed, isDrained() becomes true, and getError()
+// returns the exception
+template <typename T>
+class cbPipeline final
+{
+ public:
+  // a stage transforms an input batch in an output batch
+  using stage_fn = std::function<void(std::span<const T> in, std::vector<T>& out)>;
+
+  // stage not pinned on any cpu
+  constexpr static inline int m_noCPU {-1};
+
+  struct stageStats
+  {
+    size_t m_items {0};
+    size_t m_batches {0};
+    // number of items waiting in the input buffer of the stage
+    unsigned long m_queueDepth {0};
+    double m_itemsPerSecond {0.0};
+  };
+
+ private:
+  using cb_shptr_t = std::shared_ptr<cb<T>>;
+  using cbaddret = std::tuple<cbBase::cbStatus, size_t>;
+  using cbremret = std::tuple<cbBase::cbStatus, T, size_t>;
+
+  struct stage
+  {
+    stage_fn m_fn {};
+    int m_cpu {m_noCPU};
+    std::atomic<size_t> m_items {0};
+    std::atomic<size_t> m_batches {0};
+    std::exception_ptr m_exception {};
+    std::thread m_thread {};
+  };
+
+  const unsigned long m_queueSize {};
+  const size_t m_maxBatch {};
+  std::vector<std::unique_ptr<stage>> m_stages {};
+  // m_queues[i] is the input of stage i and the output of stage i - 1
+  std::vector<cb_shptr_t> m_queues {};
+  // m_closed[i] is set when no more items will be added to m_queues[i]
+  std::vector<std::unique_ptr<std::atomic<bool>>> m_closed {};
+  std::atomic<bool> m_stopped {false};
+  std::chrono::steady_clock::time_point m_startTime {};
+
+  static
+  void
+  _allow(const int64_t d = 0) noexcept
+  {
+    std::this_thread::yield();
+    if ( 0 == d )
+    {
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::nanoseconds(d));
+  }
+
+  void
+  _runStage(const size_t i) noexcept
+  {
+    stage& s {*m_stages[i]};
+    const cb_shptr_t& in_cb {m_queues[i]};
+    const cb_shptr_t& out_cb {m_queues[i + 1]};
+    std::vector<T> in {};
+    std::vector<T> out {};
+    in.reserve(m_maxBatch);
+    out.reserve(m_maxBatch);
+
+    if ( m_noCPU != s.m_cpu )
+    {
+      pinCurrentThread(static_cast<unsigned int>(s.m_cpu));
+    }
+
+    size_t batchSize {1};
+    while ( !m_stopped.load(std::memory_order_relaxed) )
+    {
+      in.clear();
+      while ( in.size() < batchSize )
+      {
+        auto [cbS, item, numElements] = in_cb->remove();
+        if ( cbBase::cbStatus::REMOVED != cbS )
+        {
+          break;
+        }
+        in.push_back(item);
+      }
+
+      if ( in.empty() )
+      {
+        // the input buffer must be checked again after reading the flag: items
+        // may have been added between the last remove() and the close
+        if ( m_closed[i]->load(std::memory_order_acquire) && in_cb->isEmpty() )
+        {
+          break;
+        }
+        // idle: start again from single items, sleeping between the attempts
+        batchSize = 1;
+        _allow(1'000);
+        continue;
+      }
+
+      // adaptive batching: a full batch means the input is backing up, so take
+      // more items next time; a partial batch means we are keeping up
+      batchSize = (in.size() == batchSize) ? std::min(batchSize * 2, m_maxBatch)
+                                           : std::max(batchSize / 2, size_t {1});
+
+      out.clear();
+      try
+      {
+        s.m_fn(std::span<const T>(in), out);
+      }
+      catch ( ... )
+      {
+        // the items of the batch are lost: stop all the stages, and close the
+        // downstream buffers so that the pipeline is seen as drained
+        s.m_exception = std::current_exception();
+        m_stopped.store(true, std::memory_order_relaxed);
+        for (size_t j {i + 1}; j < m_closed.size(); ++j)
+        {
+          m_closed[j]->store(true, std::memory_order_release);
+        }
+        return;
+      }
+
+      for (const T& item : out)
+      {
+        while ( cbBase::cbStatus::FULL == std::get<0>(out_cb->add(item)) )
+        {
+          if ( m_stopped.load(std::memory_order_relaxed) )
+          {
+            m_closed[i + 1]->store(true, std::memory_order_release);
+            return;
+          }
+          _allow();
+        }
+      }
+      s.m_items.fetch_add(in.size(), std::memory_order_relaxed);
+      s.m_batches.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_closed[i + 1]->store(true, std::memory_order_release);
+  }
+
+ public:
+  cbPipeline(const cbPipeline&) = delete;
+  cbPipeline& operator= (const cbPipeline&) = delete;
+  cbPipeline(const cbPipeline&&) = delete;
+  cbPipeline& operator= (const cbPipeline&&) = delete;
+
+  explicit
+  cbPipeline(const unsigned long queueSize, const size_t maxBatch = 64) noexcept(false)
+  :
+  m_queueSize(queueSize),
+  m_maxBatch(maxBatch)
+  {
+    if ( 0 == m_maxBatch )
+    {
+      throw std::invalid_argument("ERROR: The max batch size of the pipeline must not be zero");
+    }
+    // the size is checked by the circular buffer
+    m_queues.push_back(std::make_shared<cb<T>>(m_queueSize));
+    m_closed.push_back(std::make_unique<std::atomic<bool>>(false));
+  }
+
+  ~cbPipeline()
+  {
+    stop();
+    join();
+  }
+
+  // append a stage to the pipeline; must be called before start()
+  cbPipeline&
+  addStage(stage_fn fn, const int cpu = m_noCPU) noexcept(false)
+  {
+    auto s {std::make_unique<stage>()};
+    s->m_fn = std::move(fn);
+    s->m_cpu = cpu;
+    m_stages.push_back(std::move(s));
+    m_queues.push_back(std::make_shared<cb<T>>(m_queueSize));
+    m_closed.push_back(std::make_unique<std::atomic<bool>>(false));
+
+    return *this;
+  }
+
+  // start the threads of all the stages
+  void
+  start() noexcept(false)
+  {
+    m_startTime = std::chrono::steady_clock::now();
+    for (size_t i {0}; i < m_stages.size(); ++i)
+    {
+      m_stages[i]->m_thread = std::thread(&cbPipeline::_runStage, this, i);
+    }
+  }
+
+  // add an item to the input of the pipeline, if not full
+  cbaddret
+  push(const T& item) const noexcept
+  {
+    return m_queues.front()->add(item);
+  }
+
+  // remove an item from the output of the pipeline, if not empty
+  cbremret
+  pop() const noexcept
+  {
+    return m_queues.back()->remove();
+  }
+
+  // no more items will be pushed: every stage terminates once its input is
+  // closed and drained
+  void
+  close() noexcept
+  {
+    m_closed[0]->store(true, std::memory_order_release);
+  }
+
+  // true when all the stages drained their input and terminated, or one of
+  // them threw; items may still be waiting in the output of the pipeline
+  bool
+  isDrained() const noexcept
+  {
+    return m_closed.back()->load(std::memory_order_acquire);
+  }
+
+  // the exception thrown by the first failed stage, if any; to be called after
+  // join()
+  std::exception_ptr
+  getError() const noexcept
+  {
+    for (const auto& s : m_stages)
+    {
+      if ( s->m_exception )
+      {
+        return s->m_exception;
+      }
+    }
+    return nullptr;
+  }
+
+  // terminate all the stages as soon as possible, without draining
+  void
+  stop() noexcept
+  {
+    m_stopped.store(true, std::memory_order_relaxed);
+  }
+
+  void
+  join() noexcept
+  {
+    for (auto& s : m_stages)
+    {
+      if ( s->m_thread.joinable() )
+      {
+        s->m_thread.join();
+      }
+    }
+  }
+
+  // per-stage throughput and queue depth: the slowest stage is the one with the
+  // deepest input buffer
+  std::vector<stageStats>
+  getStats() const noexcept(false)
+  {
+    const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - m_startTime};
+    std::vector<stageStats> stats(m_stages.size());
+
+    for (size_t i {0}; i < m_stages.size(); ++i)
+    {
+      stats[i].m_items = m_stages[i]->m_items.load(std::memory_order_relaxed);
+      stats[i].m_batches = m_stages[i]->m_batches.load(std::memory_order_relaxed);
+      stats[i].m_queueDepth = m_queues[i]->getNumElements();
+      stats[i].m_itemsPerSecond = (elapsed.count() > 0.0) ? stats[i].m_items / elapsed.count() : 0.0;
+    }
+    return stats;
+  }
+
+  size_t
+  getNumStages() const noexcept
+  {
+    return m_stages.size();
+  }
+};  // class cbPipeline
+}  // namespace circular_buffer
@@ -0,0 +1,246 @@
+/*
+ * File:   recordBuffer.h
+ */
+#pragma once
+
+#include "circularBuffer.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+////////////////////////////////////////////////////////////////////////////////
+namespace circular_buffer
+{
+// Circular buffer of variable-length records stored in one preallocated byte
+// region: every record is a length-prefixed header followed by its payload,
+// aligned to m_alignment bytes.
+// A record never wraps around the end of the region: when it does not fit
+// before the end, a skip marker pads the rest of the region and the record is
+// stored at its start
+class cbRecords final
+{
+  using cbaddret = std::tuple<cbBase::cbStatus, size_t>;
+  using cbremret = std::tuple<cbBase::cbStatus, size_t>;
+
+  struct recordHeader
+  {
+    uint32_t m_length {0};
+    uint32_t m_reserved {0};
+  };
+
+  constexpr static inline size_t m_alignment {8};
+  constexpr static inline size_t m_headerSize {sizeof(recordHeader)};
+  // the length stored in the header of a padding area
+  constexpr static inline uint32_t m_skipMarker {std::numeric_limits<uint32_t>::max()};
+
+  constexpr
+  static
+  size_t
+  _align(const size_t n) noexcept
+  {
+    return (n + m_alignment - 1) & ~(m_alignment - 1);
+  }
+
+  const size_t m_cbSize {};
+  std::unique_ptr<std::byte[]> m_pData {};
+
+  mutable std::mutex m_mx {};
+  // head and tail are monotonic byte counters: their difference is the number
+  // of used bytes, their value modulo m_cbSize the position in the region
+  mutable uint64_t m_head {0};
+  mutable uint64_t m_tail {0};
+  mutable size_t m_numRecords {0};
+
+  recordHeader
+  _readHeader(const size_t pos) const noexcept
+  {
+    recordHeader header {};
+    std::memcpy(&header, m_pData.get() + pos, m_headerSize);
+    return header;
+  }
+
+  void
+  _writeHeader(const size_t pos, const uint32_t length) const noexcept
+  {
+    const recordHeader header {length, 0};
+    std::memcpy(m_pData.get() + pos, &header, m_headerSize);
+  }
+
+  // return the position of the front record, skipping the padding area if any;
+  // the buffer must not be empty
+  size_t
+  _frontPos() const noexcept
+  {
+    const size_t pos {m_head % m_cbSize};
+
+    if ( m_skipMarker == _readHeader(pos).m_length )
+    {
+      m_head += m_cbSize - pos;
+      return 0;
+    }
+    return pos;
+  }
+
+ public:
+  // we don't want these objects allocated on the heap
+  void* operator new(std::size_t) = delete;
+  void* operator new[](std::size_t) = delete;
+
+  void operator delete(void*) = delete;
+  void operator delete[](void*) = delete;
+
+  cbRecords(const cbRecords&) = delete;
+  cbRecords& operator= (const cbRecords&) = delete;
+  cbRecords(const cbRecords&&) = delete;
+  cbRecords& operator= (const cbRecords&&) = delete;
+
+  // the size in bytes is rounded up to the record alignment
+  explicit
+  cbRecords(const size_t cbSize) noexcept(false)
+  :
+  m_cbSize(_align(cbSize))
+  {
+    if ( 0 == m_cbSize )
+    {
+      throw std::invalid_argument("ERROR: The size of the circular buffer must not be zero");
+    }
+    m_pData = std::make_unique<std::byte[]>(m_cbSize);
+  }
+
+  // add a record in the circular buffer, if there is room for it.
+  // A record larger than the whole region never fits and always gets FULL.
+  // Return the status and the number of records after the action
+  cbaddret
+  add(const std::span<const std::byte> record) const noexcept
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    const size_t need {m_headerSize + _align(record.size())};
+    const size_t pos {m_tail % m_cbSize};
+    const size_t padding {(m_cbSize - pos < need) ? m_cbSize - pos : 0};
+
+    if ( (record.size() >= m_skipMarker) ||
+         (need + padding > m_cbSize - (m_tail - m_head)) )
+    {
+      return std::make_tuple(cbBase::cbStatus::FULL, m_numRecords);
+    }
+
+    if ( 0 != padding )
+    {
+      _writeHeader(pos, m_skipMarker);
+      m_tail += padding;
+    }
+
+    const size_t recordPos {m_tail % m_cbSize};
+    _writeHeader(recordPos, static_cast<uint32_t>(record.size()));
+    if ( !record.empty() )
+    {
+      std::memcpy(m_pData.get() + recordPos + m_headerSize, record.data(), record.size());
+    }
+    m_tail += need;
+
+    return std::make_tuple(cbBase::cbStatus::ADDED, ++m_numRecords);
+  }
+
+  // return a view of the first record in the circular buffer, no changes in it;
+  // the view is empty when the buffer is empty (use isEmpty() to tell it from
+  // an empty record) and stays valid until the record is removed
+  std::span<const std::byte>
+  getFront() const noexcept
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    if ( 0 == m_numRecords )
+    {
+      return {};
+    }
+
+    const size_t pos {_frontPos()};
+
+    return {m_pData.get() + pos + m_headerSize, _readHeader(pos).m_length};
+  }
+
+  // remove the first record from the circular buffer, if not empty.
+  // Return the status and the number of records after the action
+  cbremret
+  remove() const noexcept
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    if ( 0 == m_numRecords )
+    {
+      return std::make_tuple(cbBase::cbStatus::EMPTY, 0);
+    }
+
+    const size_t pos {_frontPos()};
+    m_head += m_headerSize + _align(_readHeader(pos).m_length);
+
+    if ( 0 == --m_numRecords )
+    {
+      // restart from the beginning of the region: no padding needed for a
+      // while
+      m_head = m_tail = 0;
+    }
+
+    return std::make_tuple(cbBase::cbStatus::REMOVED, m_numRecords);
+  }
+
+  // call f(view) for every record in the circular buffer, oldest first; the
+  // buffer is locked during the whole visit
+  template <typename F>
+  void
+  forEach(F&& f) const
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    uint64_t head {m_head};
+    for (size_t i {0}; i < m_numRecords; ++i)
+    {
+      size_t pos {head % m_cbSize};
+      recordHeader header {_readHeader(pos)};
+
+      if ( m_skipMarker == header.m_length )
+      {
+        head += m_cbSize - pos;
+        pos = 0;
+        header = _readHeader(pos);
+      }
+      f(std::span<const std::byte>(m_pData.get() + pos + m_headerSize, header.m_length));
+      head += m_headerSize + _align(header.m_length);
+    }
+  }
+
+  size_t
+  getNumRecords() const noexcept
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    return m_numRecords;
+  }
+
+  // the number of bytes in use, headers and padding included
+  size_t
+  getUsedBytes() const noexcept
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    return m_tail - m_head;
+  }
+
+  bool
+  isEmpty() const noexcept
+  {
+    std::lock_guard<std::mutex> lg(m_mx);
+
+    return (0 == m_numRecords);
+  }
+
+  constexpr
+  size_t
+  size() const noexcept
+  {
+    return m_cbSize;
+  }
+};  // class cbRecords
+}  // namespace circular_buffer
@@ -0,0 +1,138 @@
+/*
+ * File:   slabQueue.h
+ */
+#pragma once
+
+#include "circularBuffer.h"
+#include <cstdint>
+#include <limits>
+////////////////////////////////////////////////////////////////////////////////
+namespace circular_buffer
+{
+// Queue of large objects that are never copied: the objects live in a slab
+// preallocated at construction, and only their 32-bit indexes go through two
+// circular buffers, one of free slots and one of slots ready to be consumed.
+// A producer acquires a free slot, builds the object in place, and publishes
+// the slot; a consumer consumes a ready slot, reads the object in place, and
+// releases the slot, so objects are recycled and nothing is allocated at
+// steady state.
+// The object of a slot must be accessed only by the thread owning the slot:
+// the producer between acquire() and publish(), the consumer between
+// consume() and release()
+template <typename T>
+class cbSlab final
+{
+  using cbidxret = std::tuple<cbBase::cbStatus, uint32_t>;
+  using cbaddret = std::tuple<cbBase::cbStatus, size_t>;
+
+  constexpr static inline uint32_t m_noIndex {std::numeric_limits<uint32_t>::max()};
+
+  const uint32_t m_size {};
+  std::unique_ptr<T[]> m_pSlots {};
+  const cb<uint32_t> m_free;
+  const cb<uint32_t> m_ready;
+
+ public:
+  // we don't want these objects allocated on the heap
+  void* operator new(std::size_t) = delete;
+  void* operator new[](std::size_t) = delete;
+
+  void operator delete(void*) = delete;
+  void operator delete[](void*) = delete;
+
+  cbSlab(const cbSlab&) = delete;
+  cbSlab& operator= (const cbSlab&) = delete;
+  cbSlab(const cbSlab&&) = delete;
+  cbSlab& operator= (const cbSlab&&) = delete;
+
+  explicit
+  cbSlab(const uint32_t numSlots) noexcept(false)
+  :
+  m_size(numSlots),
+  m_free(numSlots),
+  m_ready(numSlots)
+  {
+    if ( (0 == m_size) || (m_noIndex == m_size) )
+    {
+      throw std::invalid_argument("ERROR: The number of slots of the slab is out of range");
+    }
+
+    m_pSlots = std::make_unique<T[]>(m_size);
+    for (uint32_t i {0}; i < m_size; ++i)
+    {
+      m_free.add(i);
+    }
+  }
+
+  // take a free slot: return FOUND and its index, or FULL when all the slots
+  // are in use
+  cbidxret
+  acquire() const noexcept
+  {
+    auto [cbS, i, numElements] = m_free.remove();
+
+    if ( cbBase::cbStatus::REMOVED != cbS )
+    {
+      return std::make_tuple(cbBase::cbStatus::FULL, m_noIndex);
+    }
+    return std::make_tuple(cbBase::cbStatus::FOUND, i);
+  }
+
+  // the object in a slot, to be built or read in place
+  T&
+  operator[](const uint32_t i) const noexcept
+  {
+    return m_pSlots[i];
+  }
+
+  // hand an acquired slot over to the consumers; return ADDED and the number
+  // of slots ready after the action.
+  // There is always room: at most m_size slots are in use
+  cbaddret
+  publish(const uint32_t i) const noexcept
+  {
+    return m_ready.add(i);
+  }
+
+  // take the oldest published slot: return REMOVED and its index, or EMPTY
+  // when no slot is ready
+  cbidxret
+  consume() const noexcept
+  {
+    auto [cbS, i, numElements] = m_ready.remove();
+
+    if ( cbBase::cbStatus::REMOVED != cbS )
+    {
+      return std::make_tuple(cbBase::cbStatus::EMPTY, m_noIndex);
+    }
+    return std::make_tuple(cbBase::cbStatus::REMOVED, i);
+  }
+
+  // give a consumed slot back to the producers; the object is left as it is
+  // and reused by the next acquire()
+  void
+  release(const uint32_t i) const noexcept
+  {
+    m_free.add(i);
+  }
+
+  unsigned long
+  getNumReady() const noexcept
+  {
+    return m_ready.getNumElements();
+  }
+
+  unsigned long
+  getNumFree() const noexcept
+  {
+    return m_free.getNumElements();
+  }
+
+  constexpr
+  uint32_t
+  size() const noexcept
+  {
+    return m_size;
+  }
+};  // class cbSlab
+}  // namespace circular_buffer
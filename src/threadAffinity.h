@@ -0,0 +1,34 @@
+/*
+ * File:   threadAffinity.h
+ */
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+////////////////////////////////////////////////////////////////////////////////
+namespace circular_buffer
+{
+// pin the thread on the given cpu.
+// Return 0 on success, the error number returned by pthread_setaffinity_np()
+// otherwise
+inline
+int
+pinThread(const pthread_t thread, const unsigned int cpu) noexcept
+{
+  // Create a cpu_set_t object representing a set of CPUs.
+  // Clear it and mark only a CPU as set.
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu, &cpuset);
+
+  return pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpuset);
+}
+
+// pin the calling thread on the given cpu
+inline
+int
+pinCurrentThread(const unsigned int cpu) noexcept
+{
+  return pinThread(pthread_self(), cpu);
+}
+}  // namespace circular_buffer
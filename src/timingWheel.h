@@ -0,0 +1,276 @@
+/*
+ * File:   timingWheel.h
+ */
+#pragma once
+
+#include "circularBuffer.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+////////////////////////////////////////////////////////////////////////////////
+namespace circular_buffer
+{
+// Hashed and hierarchical timing wheel: two circular buffers of buckets
+// advanced by a cursor, the current tick.
+// Level 0 has one bucket per tick for the timers expiring in less than
+// level0Size ticks; level 1 has one bucket every level0Size ticks for all the
+// other timers. Every time the level 0 cursor wraps around, the next level 1
+// bucket is cascaded down to level 0; a timer further than a whole level 1 turn
+// stays in its level 1 bucket until its turn comes.
+// schedule(), cancel(), and tick() are O(1) (cascading is amortized over
+// level0Size ticks); timer nodes are preallocated and linked in intrusive
+// lists, so nothing is allocated after construction.
+// Not thread-safe: meant to be driven by a single timer thread
+template <typename P = uint64_t>
+class cbTimingWheel final
+{
+ public:
+  // generation << 32 | node index: a timer id stays invalid after its timer
+  // expired or was cancelled, even when the node is reused
+  using timerId = uint64_t;
+
+ private:
+  using cbaddret = std::tuple<cbBase::cbStatus, timerId>;
+
+  constexpr static inline uint32_t m_nil {std::numeric_limits<uint32_t>::max()};
+
+  struct node
+  {
+    uint64_t m_deadline {0};
+    P m_payload {};
+    uint32_t m_prev {m_nil};
+    uint32_t m_next {m_nil};
+    // the bucket the node is linked in, m_nil when the node is free
+    uint32_t m_bucket {m_nil};
+    uint32_t m_generation {0};
+  };
+
+  const uint64_t m_level0Size {};
+  const uint64_t m_level1Size {};
+  const size_t m_capacity {};
+  std::unique_ptr<node[]> m_pNodes {};
+  // heads of the bucket lists: level 0 buckets first, then level 1 buckets
+  std::unique_ptr<uint32_t[]> m_pBuckets {};
+  // free nodes are linked by m_next
+  uint32_t m_freeList {0};
+  uint64_t m_now {0};
+  size_t m_numTimers {0};
+
+  void
+  _link(const uint32_t i, const uint32_t bucket) noexcept
+  {
+    node& n {m_pNodes[i]};
+
+    n.m_bucket = bucket;
+    n.m_prev = m_nil;
+    n.m_next = m_pBuckets[bucket];
+    if ( m_nil != n.m_next )
+    {
+      m_pNodes[n.m_next].m_prev = i;
+    }
+    m_pBuckets[bucket] = i;
+  }
+
+  void
+  _unlink(const uint32_t i) noexcept
+  {
+    node& n {m_pNodes[i]};
+
+    if ( m_nil != n.m_prev )
+    {
+      m_pNodes[n.m_prev].m_next = n.m_next;
+    }
+    else
+    {
+      m_pBuckets[n.m_bucket] = n.m_next;
+    }
+    if ( m_nil != n.m_next )
+    {
+      m_pNodes[n.m_next].m_prev = n.m_prev;
+    }
+  }
+
+  void
+  _insert(const uint32_t i) noexcept
+  {
+    const uint64_t deadline {m_pNodes[i].m_deadline};
+
+    if ( deadline - m_now < m_level0Size )
+    {
+      _link(i, static_cast<uint32_t>(deadline % m_level0Size));
+    }
+    else
+    {
+      _link(i, static_cast<uint32_t>(m_level0Size + (deadline / m_level0Size) % m_level1Size));
+    }
+  }
+
+  void
+  _free(const uint32_t i) noexcept
+  {
+    node& n {m_pNodes[i]};
+
+    n.m_bucket = m_nil;
+    ++n.m_generation;
+    n.m_next = m_freeList;
+    m_freeList = i;
+    --m_numTimers;
+  }
+
+  // move the timers of the current level 1 bucket closer to their deadline
+  void
+  _cascade() noexcept
+  {
+    const uint32_t bucket {static_cast<uint32_t>(m_level0Size + (m_now / m_level0Size) % m_level1Size)};
+    uint32_t i {m_pBuckets[bucket]};
+
+    // detach the whole list first: timers not due in this turn go back in it
+    m_pBuckets[bucket] = m_nil;
+    while ( m_nil != i )
+    {
+      const uint32_t next {m_pNodes[i].m_next};
+      _insert(i);
+      i = next;
+    }
+  }
+
+ public:
+  // we don't want these objects allocated on the heap
+  void* operator new(std::size_t) = delete;
+  void* operator new[](std::size_t) = delete;
+
+  void operator delete(void*) = delete;
+  void operator delete[](void*) = delete;
+
+  cbTimingWheel(const cbTimingWheel&) = delete;
+  cbTimingWheel& operator= (const cbTimingWheel&) = delete;
+  cbTimingWheel(const cbTimingWheel&&) = delete;
+  cbTimingWheel& operator= (const cbTimingWheel&&) = delete;
+
+  // capacity is the max number of timers scheduled at the same time
+  cbTimingWheel(const size_t capacity,
+                const uint64_t level0Size = 256,
+                const uint64_t level1Size = 64) noexcept(false)
+  :
+  m_level0Size(level0Size),
+  m_level1Size(level1Size),
+  m_capacity(capacity)
+  {
+    if ( (0 == m_capacity) || (m_capacity >= m_nil) )
+    {
+      throw std::invalid_argument("ERROR: The capacity of the timing wheel is out of range");
+    }
+    if ( (0 == m_level0Size) || (0 == m_level1Size) || (m_level0Size + m_level1Size >= m_nil) )
+    {
+      throw std::invalid_argument("ERROR: The size of the levels of the timing wheel is out of range");
+    }
+
+    m_pNodes = std::make_unique<node[]>(m_capacity);
+    for (uint32_t i {0}; i < m_capacity; ++i)
+    {
+      m_pNodes[i].m_next = (i + 1 < m_capacity) ? i + 1 : m_nil;
+    }
+    m_pBuckets = std::make_unique<uint32_t[]>(m_level0Size + m_level1Size);
+    std::fill(m_pBuckets.get(), m_pBuckets.get() + m_level0Size + m_level1Size, m_nil);
+  }
+
+  // schedule a timer expiring delay ticks from now (at the next tick when delay
+  // is 0); return ADDED and the timer id, or FULL and an id that cancel()
+  // always rejects when all the timer nodes are in use
+  cbaddret
+  schedule(const uint64_t delay, const P& payload) noexcept
+  {
+    if ( m_nil == m_freeList )
+    {
+      return std::make_tuple(cbBase::cbStatus::FULL, timerId {m_nil});
+    }
+
+    const uint32_t i {m_freeList};
+    node& n {m_pNodes[i]};
+
+    m_freeList = n.m_next;
+    n.m_deadline = m_now + std::max(delay, uint64_t {1});
+    n.m_payload = payload;
+    _insert(i);
+    ++m_numTimers;
+
+    return std::make_tuple(cbBase::cbStatus::ADDED,
+                           (static_cast<timerId>(n.m_generation) << 32) | i);
+  }
+
+  // cancel a timer; return false when the timer already expired or was
+  // cancelled
+  bool
+  cancel(const timerId id) noexcept
+  {
+    const uint32_t i {static_cast<uint32_t>(id)};
+
+    if ( (i >= m_capacity) ||
+         (m_nil == m_pNodes[i].m_bucket) ||
+         (m_pNodes[i].m_generation != static_cast<uint32_t>(id >> 32)) )
+    {
+      return false;
+    }
+
+    _unlink(i);
+    _free(i);
+
+    return true;
+  }
+
+  // advance the wheel by one tick and call onExpire(payload) for every timer
+  // expiring at the new tick; onExpire may schedule and cancel timers.
+  // Return the number of expired timers
+  template <typename F>
+  size_t
+  tick(F&& onExpire)
+  {
+    ++m_now;
+    if ( 0 == m_now % m_level0Size )
+    {
+      _cascade();
+    }
+
+    const uint32_t bucket {static_cast<uint32_t>(m_now % m_level0Size)};
+    size_t numExpired {0};
+
+    // one timer at a time: onExpire may cancel the other timers of the bucket
+    while ( m_nil != m_pBuckets[bucket] )
+    {
+      const uint32_t i {m_pBuckets[bucket]};
+      const P payload {m_pNodes[i].m_payload};
+
+      _unlink(i);
+      _free(i);
+      ++numExpired;
+      onExpire(payload);
+    }
+    return numExpired;
+  }
+
+  uint64_t
+  now() const noexcept
+  {
+    return m_now;
+  }
+
+  size_t
+  getNumTimers() const noexcept
+  {
+    return m_numTimers;
+  }
+
+  bool
+  isEmpty() const noexcept
+  {
+    return (0 == m_numTimers);
+  }
+
+  constexpr
+  size_t
+  size() const noexcept
+  {
+    return m_capacity;
+  }
+};  // class cbTimingWheel
+}  // namespace circular_buffer
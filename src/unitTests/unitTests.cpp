@@ -1,7 +1,23 @@
 /* 
  * File:   unitTests.cpp
  */
+#include "../binaryLogger.h"
 #include "../circularBuffer.h"
+#include "../columnarBuffer.h"
+#include "../compressedBuffer.h"
+#include "../conflatingBuffer.h"
+#include "../recordBuffer.h"
+#include "../pipeline.h"
+#include "../workStealingDeque.h"
+#include "../executor.h"
+#include "../timingWheel.h"
+#include "../slabQueue.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <sstream>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
@@ -332,6 +348,1464 @@ TEST(circularBuffer, test_15)
   ASSERT_EQ(0, numElements);
 }
 
+TEST(circularBuffer, test_16)
+{
+  // Size of the circular buffer used in the test
+  constexpr unsigned int cbsize {2};
+  cb_t aCircularBuffer(cbsize, circular_buffer::cbBase::cbAddMode::FLAT_COMBINING);
+
+  circular_buffer::cbBase::cbStatus cbS {};
+  cbtype item {};
+  size_t numElements {};
+
+  ASSERT_EQ(circular_buffer::cbBase::cbAddMode::FLAT_COMBINING, aCircularBuffer.addMode());
+
+  aCircularBuffer.add(123);
+  std::tie(cbS, numElements) = aCircularBuffer.add(456);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, cbS);
+  ASSERT_EQ(2, numElements);
+
+  std::tie(cbS, numElements) = aCircularBuffer.add(789);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::FULL, cbS);
+  ASSERT_EQ(2, numElements);
+
+  std::tie(cbS, item, numElements) = aCircularBuffer.remove();
+  ASSERT_EQ(cbtype {123}, item);
+  std::tie(cbS, item, numElements) = aCircularBuffer.remove();
+  ASSERT_EQ(cbtype {456}, item);
+}
+
+TEST(circularBuffer, test_17)
+{
+  // more producer threads than publication slots, so that some of them share
+  // a slot and fall back to the lock
+  constexpr unsigned int numThreads {80};
+  constexpr unsigned int itemsPerThread {500};
+  circular_buffer::cb<uint32_t> aCircularBuffer(numThreads * itemsPerThread,
+                                                circular_buffer::cbBase::cbAddMode::FLAT_COMBINING);
+
+  std::vector<std::thread> producers {};
+  for (uint32_t t {0}; t < numThreads; ++t)
+  {
+    producers.emplace_back([&aCircularBuffer, t] ()
+                           {
+                             for (uint32_t i {0}; i < itemsPerThread; ++i)
+                             {
+                               aCircularBuffer.add(t * itemsPerThread + i);
+                             }
+                           });
+  }
+  for (auto& p : producers)
+  {
+    p.join();
+  }
+
+  ASSERT_EQ(true, aCircularBuffer.isFull());
+
+  // every item was added exactly once and the items of a thread are in order
+  std::vector<uint32_t> lastItem(numThreads, 0);
+  std::vector<bool> seen(numThreads * itemsPerThread, false);
+  while ( true )
+  {
+    auto [cbS, item, numElements] = aCircularBuffer.remove();
+    if ( circular_buffer::cbBase::cbStatus::EMPTY == cbS )
+    {
+      break;
+    }
+    ASSERT_FALSE(seen[item]);
+    seen[item] = true;
+    ASSERT_LE(lastItem[item / itemsPerThread], item);
+    lastItem[item / itemsPerThread] = item;
+  }
+  ASSERT_EQ(seen.end(), std::find(seen.begin(), seen.end(), false));
+}
+
+TEST(circularBuffer, test_18)
+{
+  // Size of the circular buffer used in the test
+  constexpr unsigned int cbsize {3};
+  cb_t aCircularBuffer(cbsize);
+
+  circular_buffer::cbBase::cbStatus cbS {};
+  cbtype item {};
+  size_t numElements {};
+  uint64_t sequence {};
+
+  // sequence numbers start from 0 and are monotonic across removes
+  std::tie(cbS, numElements, sequence) = aCircularBuffer.addSeq(100);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, cbS);
+  ASSERT_EQ(0, sequence);
+  aCircularBuffer.add(101);
+  aCircularBuffer.remove();
+  aCircularBuffer.add(102);
+  std::tie(cbS, numElements, sequence) = aCircularBuffer.addSeq(103);
+  ASSERT_EQ(3, sequence);
+  ASSERT_EQ(3, numElements);
+  std::tie(cbS, numElements, sequence) = aCircularBuffer.addSeq(104);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::FULL, cbS);
+
+  std::tie(cbS, item) = aCircularBuffer.get(0);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::EVICTED, cbS);
+  std::tie(cbS, item) = aCircularBuffer.get(2);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::FOUND, cbS);
+  ASSERT_EQ(cbtype {102}, item);
+  std::tie(cbS, item) = aCircularBuffer.get(4);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::NOT_PRODUCED, cbS);
+
+  ASSERT_EQ("EVICTED", aCircularBuffer.cbStatusString(circular_buffer::cbBase::cbStatus::EVICTED));
+  ASSERT_EQ("NOT_PRODUCED", aCircularBuffer.cbStatusString(circular_buffer::cbBase::cbStatus::NOT_PRODUCED));
+}
+
+TEST(circularBuffer, test_19)
+{
+  // Size of the circular buffer used in the test
+  constexpr unsigned int cbsize {4};
+  cb_t aCircularBuffer(cbsize);
+
+  circular_buffer::cbBase::cbStatus cbS {};
+  size_t numItems {};
+  std::array<cbtype, cbsize> out {};
+
+  // sequence numbers 0..5 added, 0..1 removed: the items wrap around the end
+  for (cbtype i {0}; i < 4; ++i)
+  {
+    aCircularBuffer.add(i * 10);
+  }
+  aCircularBuffer.remove();
+  aCircularBuffer.remove();
+  aCircularBuffer.add(40);
+  aCircularBuffer.add(50);
+
+  std::tie(cbS, numItems) = aCircularBuffer.getRange(2, 6, out);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::FOUND, cbS);
+  ASSERT_EQ(4, numItems);
+  ASSERT_THAT(out, ElementsAre(20, 30, 40, 50));
+
+  // at most out.size() items are copied
+  std::tie(cbS, numItems) = aCircularBuffer.getRange(3, 6, std::span<cbtype>(out.data(), 2));
+  ASSERT_EQ(2, numItems);
+  ASSERT_EQ(cbtype {30}, out[0]);
+  ASSERT_EQ(cbtype {40}, out[1]);
+
+  std::tie(cbS, numItems) = aCircularBuffer.getRange(1, 3, out);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::EVICTED, cbS);
+  ASSERT_EQ(0, numItems);
+  std::tie(cbS, numItems) = aCircularBuffer.getRange(4, 7, out);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::NOT_PRODUCED, cbS);
+  ASSERT_EQ(0, numItems);
+}
+
+TEST(circularBuffer, test_20)
+{
+  // Size of the circular buffer used in the test
+  constexpr unsigned int cbsize {4};
+  circular_buffer::cb<uint32_t> aCircularBuffer(cbsize);
+
+  int fds[2] {};
+  ASSERT_EQ(0, pipe(fds));
+
+  circular_buffer::cbBase::cbStatus cbS {};
+  ssize_t n {};
+
+  std::tie(cbS, n) = aCircularBuffer.drainTo(fds[1]);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::EMPTY, cbS);
+  ASSERT_EQ(0, n);
+
+  // the live items wrap around the end: two segments are written
+  for (uint32_t i {1}; i <= 3; ++i)
+  {
+    aCircularBuffer.add(i);
+  }
+  aCircularBuffer.remove();
+  aCircularBuffer.add(4);
+  aCircularBuffer.add(5);
+
+  std::tie(cbS, n) = aCircularBuffer.drainTo(fds[1]);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::REMOVED, cbS);
+  ASSERT_EQ(4 * sizeof(uint32_t), n);
+  ASSERT_EQ(true, aCircularBuffer.isEmpty());
+
+  std::array<uint32_t, 4> out {};
+  ASSERT_EQ(sizeof(out), read(fds[0], out.data(), sizeof(out)));
+  ASSERT_THAT(out, ElementsAre(2, 3, 4, 5));
+
+  // the sequence numbers follow the drained items
+  aCircularBuffer.add(6);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::FOUND, std::get<0>(aCircularBuffer.get(5)));
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(circularBuffer, test_21)
+{
+  // Size of the circular buffer used in the test
+  constexpr unsigned int cbsize {3};
+  circular_buffer::cb<uint32_t> aCircularBuffer(cbsize);
+
+  int fds[2] {};
+  ASSERT_EQ(0, pipe(fds));
+
+  circular_buffer::cbBase::cbStatus cbS {};
+  uint32_t item {};
+  size_t numElements {};
+  ssize_t n {};
+
+  // one item and a half: only the complete item is added
+  const std::array<uint32_t, 2> in {0x11111111, 0x22222222};
+  ASSERT_EQ(6, write(fds[1], in.data(), 6));
+  std::tie(cbS, n) = aCircularBuffer.fillFrom(fds[0]);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, cbS);
+  ASSERT_EQ(6, n);
+  ASSERT_EQ(1, aCircularBuffer.getNumElements());
+
+  // the rest of the second item completes it
+  ASSERT_EQ(2, write(fds[1], reinterpret_cast<const char*>(in.data()) + 6, 2));
+  std::tie(cbS, n) = aCircularBuffer.fillFrom(fds[0]);
+  ASSERT_EQ(2, n);
+  ASSERT_EQ(2, aCircularBuffer.getNumElements());
+
+  std::tie(cbS, item, numElements) = aCircularBuffer.remove();
+  ASSERT_EQ(in[0], item);
+  std::tie(cbS, item, numElements) = aCircularBuffer.remove();
+  ASSERT_EQ(in[1], item);
+
+  // end of file
+  close(fds[1]);
+  std::tie(cbS, n) = aCircularBuffer.fillFrom(fds[0]);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, cbS);
+  ASSERT_EQ(0, n);
+  close(fds[0]);
+
+  // error
+  std::tie(cbS, n) = aCircularBuffer.fillFrom(-1);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::UNKNOWN, cbS);
+  ASSERT_EQ(-1, n);
+}
+
+TEST(circularBuffer, test_22)
+{
+  // Size of the circular buffer used in the test
+  constexpr unsigned int cbsize {5};
+  circular_buffer::cb<uint64_t> source(cbsize);
+  circular_buffer::cb<uint64_t> destination(cbsize);
+
+  std::FILE* pFile {std::tmpfile()};
+  ASSERT_NE(nullptr, pFile);
+  const int fd {fileno(pFile)};
+
+  for (uint64_t i {0}; i < cbsize; ++i)
+  {
+    source.add(i * 1'000'000'007);
+  }
+  ASSERT_EQ(cbsize * sizeof(uint64_t), std::get<1>(source.drainTo(fd)));
+
+  // fill the destination, wrapped around the end, from the file
+  destination.add(0);
+  destination.add(0);
+  destination.remove();
+  destination.remove();
+  ASSERT_EQ(0, lseek(fd, 0, SEEK_SET));
+  ASSERT_EQ(cbsize * sizeof(uint64_t), std::get<1>(destination.fillFrom(fd)));
+  ASSERT_EQ(true, destination.isFull());
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::FULL, std::get<0>(destination.fillFrom(fd)));
+
+  for (uint64_t i {0}; i < cbsize; ++i)
+  {
+    ASSERT_EQ(i * 1'000'000'007, std::get<1>(destination.remove()));
+  }
+  std::fclose(pFile);
+}
+
+TEST(circularBuffer, test_23)
+{
+  // records larger than what a non-blocking pipe takes at once
+  using record_t = std::array<char, 3'000>;
+  circular_buffer::cb<record_t> aCircularBuffer(2);
+
+  int fds[2] {};
+  ASSERT_EQ(0, pipe2(fds, O_NONBLOCK));
+  ASSERT_LE(0, fcntl(fds[1], F_SETPIPE_SZ, 4'096));
+  const auto pipeSize {static_cast<size_t>(fcntl(fds[1], F_GETPIPE_SZ))};
+  ASSERT_LT(pipeSize, 2 * sizeof(record_t));
+
+  record_t a {};
+  record_t b {};
+  a.fill('a');
+  b.fill('b');
+  aCircularBuffer.add(a);
+  aCircularBuffer.add(b);
+
+  // the first record and a part of the second one are written
+  auto [cbS, n] = aCircularBuffer.drainTo(fds[1]);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::REMOVED, cbS);
+  ASSERT_EQ(pipeSize, n);
+  ASSERT_EQ(1, aCircularBuffer.getNumElements());
+
+  // remove() does not take the record half written
+  auto [removeS, item, numElements] = aCircularBuffer.remove();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::UNKNOWN, removeS);
+  ASSERT_EQ(1, numElements);
+
+  std::vector<char> out(2 * sizeof(record_t));
+  ASSERT_EQ(static_cast<ssize_t>(pipeSize), read(fds[0], out.data(), out.size()));
+
+  // drainTo() completes it
+  std::tie(cbS, n) = aCircularBuffer.drainTo(fds[1]);
+  ASSERT_EQ(2 * sizeof(record_t) - pipeSize, n);
+  ASSERT_EQ(true, aCircularBuffer.isEmpty());
+  ASSERT_EQ(n, read(fds[0], out.data() + pipeSize, out.size()));
+  ASSERT_EQ(out.size() / 2, std::count(out.begin(), out.begin() + sizeof(record_t), 'a'));
+  ASSERT_EQ(out.size() / 2, std::count(out.begin() + sizeof(record_t), out.end(), 'b'));
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(columnarBuffer, test_1)
+{
+  using cbc_t = circular_buffer::cbColumnar<uint64_t, uint32_t, double>;
+
+  EXPECT_THROW(cbc_t aColumnarBuffer(0), std::invalid_argument);
+}
+
+TEST(columnarBuffer, test_2)
+{
+  // Size of the circular buffer used in the test
+  constexpr unsigned int cbsize {2};
+  circular_buffer::cbColumnar<uint64_t, uint32_t, double> aColumnarBuffer(cbsize);
+
+  circular_buffer::cbBase::cbStatus cbS {};
+  size_t numElements {};
+
+  std::tie(cbS, numElements) = aColumnarBuffer.add(10, 1, 1.5);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, cbS);
+  ASSERT_EQ(1, numElements);
+
+  aColumnarBuffer.add(20, 2, 2.5);
+  std::tie(cbS, numElements) = aColumnarBuffer.add(30, 3, 3.5);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::FULL, cbS);
+  ASSERT_EQ(2, numElements);
+  ASSERT_EQ(true, aColumnarBuffer.isFull());
+
+  std::tuple<uint64_t, uint32_t, double> row {};
+  std::tie(cbS, row, numElements) = aColumnarBuffer.remove();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::REMOVED, cbS);
+  ASSERT_EQ(std::make_tuple(uint64_t {10}, uint32_t {1}, 1.5), row);
+  ASSERT_EQ(1, numElements);
+
+  std::tie(cbS, row, numElements) = aColumnarBuffer.remove();
+  ASSERT_EQ(std::make_tuple(uint64_t {20}, uint32_t {2}, 2.5), row);
+
+  std::tie(cbS, row, numElements) = aColumnarBuffer.remove();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::EMPTY, cbS);
+  ASSERT_EQ(0, numElements);
+}
+
+TEST(columnarBuffer, test_3)
+{
+  // Size of the circular buffer used in the test
+  constexpr unsigned int cbsize {4};
+  circular_buffer::cbColumnar<uint64_t, uint32_t> aColumnarBuffer(cbsize);
+
+  // move the head forward so that the live range wraps around the end
+  for (uint32_t i {1}; i <= 3; ++i)
+  {
+    aColumnarBuffer.add(i * 100, i);
+  }
+  aColumnarBuffer.remove();
+  aColumnarBuffer.remove();
+  for (uint32_t i {4}; i <= 6; ++i)
+  {
+    aColumnarBuffer.add(i * 100, i);
+  }
+
+  auto [first, second] = aColumnarBuffer.getColumn<1>();
+
+  ASSERT_EQ(2, first.size());
+  ASSERT_EQ(2, second.size());
+
+  std::vector<uint32_t> ids {};
+  ids.insert(ids.end(), first.begin(), first.end());
+  ids.insert(ids.end(), second.begin(), second.end());
+  ASSERT_THAT(ids, ElementsAre(3, 4, 5, 6));
+
+  auto [tsFirst, tsSecond] = aColumnarBuffer.getColumn<0>();
+  ASSERT_EQ(300, tsFirst.front());
+  ASSERT_EQ(600, tsSecond.back());
+}
+
+TEST(compressedBuffer, test_1)
+{
+  using cbz_t = circular_buffer::cbCompressed<uint64_t>;
+
+  EXPECT_THROW(cbz_t aCompressedBuffer(0, 64), std::invalid_argument);
+  // a uint64_t varint can take up to 10 bytes
+  EXPECT_THROW(cbz_t aCompressedBuffer(4, 9), std::invalid_argument);
+  EXPECT_NO_THROW(cbz_t aCompressedBuffer(4, 10));
+}
+
+TEST(compressedBuffer, test_2)
+{
+  circular_buffer::cbCompressed<int32_t> aCompressedBuffer(4, 64);
+
+  const std::vector<int32_t> values {0, 1, -1, 1000, -100000,
+                                     std::numeric_limits<int32_t>::max(),
+                                     std::numeric_limits<int32_t>::min(), 7};
+  for (auto v : values)
+  {
+    aCompressedBuffer.add(v);
+  }
+  ASSERT_EQ(values.size(), aCompressedBuffer.getNumValues());
+
+  std::vector<int32_t> decoded {};
+  aCompressedBuffer.forEach([&decoded] (int32_t v) { decoded.push_back(v); });
+  ASSERT_EQ(values, decoded);
+}
+
+TEST(compressedBuffer, test_3)
+{
+  // 2 blocks of 16 bytes: with small deltas every value after the first one
+  // takes 1 byte, so a block holds 17 values
+  circular_buffer::cbCompressed<uint32_t> aCompressedBuffer(2, 16);
+
+  // a counter wrapping around its max value still gives small deltas
+  uint32_t counter {std::numeric_limits<uint32_t>::max() - 10};
+  for (int i {0}; i < 34; ++i)
+  {
+    aCompressedBuffer.add(counter++);
+  }
+  ASSERT_EQ(2, aCompressedBuffer.getNumBlocks());
+  ASSERT_EQ(34, aCompressedBuffer.getNumValues());
+
+  // the next value evicts the oldest block
+  circular_buffer::cbBase::cbStatus cbS {};
+  size_t numValues {};
+  std::tie(cbS, numValues) = aCompressedBuffer.add(counter);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, cbS);
+  ASSERT_EQ(18, numValues);
+
+  std::vector<uint32_t> decoded {};
+  aCompressedBuffer.forEach([&decoded] (uint32_t v) { decoded.push_back(v); });
+  ASSERT_EQ(18, decoded.size());
+  ASSERT_EQ(counter - 17, decoded.front());
+  ASSERT_EQ(counter, decoded.back());
+
+  std::tie(cbS, numValues) = aCompressedBuffer.removeBlock();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::REMOVED, cbS);
+  ASSERT_EQ(1, numValues);
+  aCompressedBuffer.removeBlock();
+  std::tie(cbS, numValues) = aCompressedBuffer.removeBlock();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::EMPTY, cbS);
+  ASSERT_EQ(true, aCompressedBuffer.isEmpty());
+}
+
+static
+std::span<const std::byte>
+asBytes(const std::string& s)
+{
+  return std::as_bytes(std::span<const char>(s));
+}
+
+static
+std::string
+asString(const std::span<const std::byte> record)
+{
+  return std::string(reinterpret_cast<const char*>(record.data()), record.size());
+}
+
+TEST(recordBuffer, test_1)
+{
+  EXPECT_THROW(circular_buffer::cbRecords aRecordBuffer(0), std::invalid_argument);
+
+  // the size is rounded up to the record alignment
+  circular_buffer::cbRecords aRecordBuffer(61);
+  ASSERT_EQ(64, aRecordBuffer.size());
+  ASSERT_EQ(true, aRecordBuffer.isEmpty());
+  ASSERT_EQ(true, aRecordBuffer.getFront().empty());
+}
+
+TEST(recordBuffer, test_2)
+{
+  circular_buffer::cbRecords aRecordBuffer(64);
+
+  circular_buffer::cbBase::cbStatus cbS {};
+  size_t numRecords {};
+
+  // every record takes 8 bytes of header plus its aligned payload
+  std::tie(cbS, numRecords) = aRecordBuffer.add(asBytes("hello"));
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, cbS);
+  ASSERT_EQ(1, numRecords);
+  std::tie(cbS, numRecords) = aRecordBuffer.add(asBytes("a log line of 24 bytes.."));
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, cbS);
+  ASSERT_EQ(2, numRecords);
+  ASSERT_EQ(48, aRecordBuffer.getUsedBytes());
+
+  std::tie(cbS, numRecords) = aRecordBuffer.add(asBytes("does not fit"));
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::FULL, cbS);
+  ASSERT_EQ(2, numRecords);
+
+  // an empty record is a valid record
+  std::tie(cbS, numRecords) = aRecordBuffer.add({});
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, cbS);
+
+  std::vector<std::string> records {};
+  aRecordBuffer.forEach([&records] (std::span<const std::byte> r) { records.push_back(asString(r)); });
+  ASSERT_THAT(records, ElementsAre("hello", "a log line of 24 bytes..", ""));
+
+  ASSERT_EQ("hello", asString(aRecordBuffer.getFront()));
+  std::tie(cbS, numRecords) = aRecordBuffer.remove();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::REMOVED, cbS);
+  ASSERT_EQ(2, numRecords);
+  ASSERT_EQ("a log line of 24 bytes..", asString(aRecordBuffer.getFront()));
+}
+
+TEST(recordBuffer, test_3)
+{
+  circular_buffer::cbRecords aRecordBuffer(64);
+
+  // a record larger than the whole region never fits
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::FULL,
+            std::get<0>(aRecordBuffer.add(asBytes(std::string(57, 'x')))));
+
+  aRecordBuffer.add(asBytes(std::string(20, 'a')));  // bytes [0, 32)
+  aRecordBuffer.add(asBytes(std::string(8, 'b')));   // bytes [32, 48)
+  aRecordBuffer.remove();
+
+  // 16 bytes left before the end: the record goes to the start of the region
+  // and the end is padded with a skip marker
+  circular_buffer::cbBase::cbStatus cbS {};
+  size_t numRecords {};
+  std::tie(cbS, numRecords) = aRecordBuffer.add(asBytes(std::string(20, 'c')));
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, cbS);
+  ASSERT_EQ(2, numRecords);
+  // the region is now full: 16 bytes of the 'b' record, 16 bytes of padding and
+  // 32 bytes of the 'c' record
+  ASSERT_EQ(64, aRecordBuffer.getUsedBytes());
+
+  ASSERT_EQ(std::string(8, 'b'), asString(aRecordBuffer.getFront()));
+  aRecordBuffer.remove();
+  ASSERT_EQ(std::string(20, 'c'), asString(aRecordBuffer.getFront()));
+  aRecordBuffer.remove();
+
+  std::tie(cbS, numRecords) = aRecordBuffer.remove();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::EMPTY, cbS);
+  ASSERT_EQ(0, aRecordBuffer.getUsedBytes());
+}
+
+TEST(pipeline, test_1)
+{
+  EXPECT_THROW(circular_buffer::cbPipeline<int> aPipeline(0), std::invalid_argument);
+  EXPECT_THROW(circular_buffer::cbPipeline<int> aPipeline(8, 0), std::invalid_argument);
+}
+
+TEST(pipeline, test_2)
+{
+  constexpr int numItems {10'000};
+  circular_buffer::cbPipeline<int> aPipeline(16);
+
+  // double every item, then drop the odd ones and add 1
+  aPipeline.addStage([] (std::span<const int> in, std::vector<int>& out)
+                     {
+                       for (auto i : in) { out.push_back(2 * i); }
+                     })
+           .addStage([] (std::span<const int> in, std::vector<int>& out)
+                     {
+                       for (auto i : in) { if ( 0 == i % 4 ) { out.push_back(i + 1); } }
+                     });
+  ASSERT_EQ(2, aPipeline.getNumStages());
+  aPipeline.start();
+
+  std::vector<int> results {};
+  int next {0};
+  auto popItem = [&aPipeline, &results] ()
+  {
+    auto [cbS, item, numElements] = aPipeline.pop();
+    if ( circular_buffer::cbBase::cbStatus::REMOVED == cbS )
+    {
+      results.push_back(item);
+    }
+    return cbS;
+  };
+
+  while ( !aPipeline.isDrained() )
+  {
+    if ( (next < numItems) &&
+         (circular_buffer::cbBase::cbStatus::ADDED == std::get<0>(aPipeline.push(next))) &&
+         (++next == numItems) )
+    {
+      aPipeline.close();
+    }
+    popItem();
+  }
+  aPipeline.join();
+  while ( circular_buffer::cbBase::cbStatus::REMOVED == popItem() ) {}
+
+  // items go through the stages in order
+  ASSERT_EQ(numItems / 2, results.size());
+  for (size_t i {0}; i < results.size(); ++i)
+  {
+    ASSERT_EQ(static_cast<int>(4 * i + 1), results[i]);
+  }
+
+  auto stats {aPipeline.getStats()};
+  ASSERT_EQ(2, stats.size());
+  ASSERT_EQ(numItems, stats[0].m_items);
+  ASSERT_EQ(numItems, stats[1].m_items);
+  ASSERT_EQ(0, stats[0].m_queueDepth);
+  ASSERT_LE(stats[0].m_batches, stats[0].m_items);
+}
+
+TEST(pipeline, test_3)
+{
+  // checking or closing pipelines not started yet
+  circular_buffer::cbPipeline<int> aPipeline(16);
+
+  aPipeline.addStage([] (std::span<const int> in, std::vector<int>& out)
+                     {
+                       for (auto i : in)
+                       {
+                         if ( 3 == i )
+                         {
+                           throw std::runtime_error("bad item");
+                         }
+                         out.push_back(i);
+                       }
+                     })
+           .addStage([] (std::span<const int> in, std::vector<int>& out)
+                     {
+                       out.insert(out.end(), in.begin(), in.end());
+                     });
+  ASSERT_EQ(false, aPipeline.isDrained());
+
+  circular_buffer::cbPipeline<int> notStartedPipeline(16);
+  notStartedPipeline.addStage([] (std::span<const int>, std::vector<int>&) {});
+  notStartedPipeline.close();
+  ASSERT_EQ(false, notStartedPipeline.isDrained());
+
+  // a throwing stage stops the pipeline instead of terminating the process
+  aPipeline.start();
+  for (int i {0}; i < 5; ++i)
+  {
+    aPipeline.push(i);
+  }
+  while ( !aPipeline.isDrained() )
+  {
+    std::this_thread::yield();
+  }
+  aPipeline.join();
+  ASSERT_THROW(std::rethrow_exception(aPipeline.getError()), std::runtime_error);
+}
+
+TEST(pipeline, test_4)
+{
+  // a pipeline stopped while a stage waits for room in its output is drained
+  circular_buffer::cbPipeline<int> aPipeline(2);
+
+  aPipeline.addStage([] (std::span<const int> in, std::vector<int>& out)
+                     {
+                       for (auto i : in) { out.insert(out.end(), 4, i); }
+                     });
+  aPipeline.start();
+  aPipeline.push(1);
+  while ( 0 != aPipeline.getStats()[0].m_queueDepth )
+  {
+    std::this_thread::yield();
+  }
+  // let the stage fill its output
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  aPipeline.stop();
+  aPipeline.join();
+  ASSERT_EQ(true, aPipeline.isDrained());
+  ASSERT_EQ(nullptr, aPipeline.getError());
+}
+
+TEST(workStealingDeque, test_1)
+{
+  EXPECT_THROW(circular_buffer::cbDeque<int> aDeque(0), std::invalid_argument);
+
+  // the size is rounded up to a power of 2
+  circular_buffer::cbDeque<int> aDeque(3);
+  ASSERT_EQ(4, aDeque.size());
+  ASSERT_EQ(true, aDeque.isEmpty());
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::EMPTY, std::get<0>(aDeque.pop()));
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::EMPTY, std::get<0>(aDeque.steal()));
+}
+
+TEST(workStealingDeque, test_2)
+{
+  circular_buffer::cbDeque<int> aDeque(2);
+
+  circular_buffer::cbBase::cbStatus cbS {};
+  int item {};
+
+  // the deque grows when full
+  for (int i {1}; i <= 5; ++i)
+  {
+    aDeque.push(i);
+  }
+  ASSERT_EQ(8, aDeque.size());
+  ASSERT_EQ(5, aDeque.getNumElements());
+
+  // the owner works LIFO at the bottom, thieves FIFO at the top
+  std::tie(cbS, item) = aDeque.pop();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::REMOVED, cbS);
+  ASSERT_EQ(5, item);
+  std::tie(cbS, item) = aDeque.steal();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::REMOVED, cbS);
+  ASSERT_EQ(1, item);
+  std::tie(cbS, item) = aDeque.pop();
+  ASSERT_EQ(4, item);
+  std::tie(cbS, item) = aDeque.steal();
+  ASSERT_EQ(2, item);
+  std::tie(cbS, item) = aDeque.pop();
+  ASSERT_EQ(3, item);
+  std::tie(cbS, item) = aDeque.pop();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::EMPTY, cbS);
+}
+
+TEST(workStealingDeque, test_3)
+{
+  // stress test: the owner pushes and pops while thieves steal; every item must
+  // be taken exactly once
+  constexpr int numItems {200'000};
+  constexpr int numThieves {3};
+  circular_buffer::cbDeque<int> aDeque(4);
+  std::vector<std::atomic<int>> taken(numItems);
+  std::atomic<bool> done {false};
+
+  std::vector<std::thread> thieves {};
+  for (int t {0}; t < numThieves; ++t)
+  {
+    thieves.emplace_back([&aDeque, &taken, &done] ()
+                         {
+                           while ( !done.load() || !aDeque.isEmpty() )
+                           {
+                             auto [cbS, item] = aDeque.steal();
+                             if ( circular_buffer::cbBase::cbStatus::REMOVED == cbS )
+                             {
+                               taken[item].fetch_add(1);
+                             }
+                             else
+                             {
+                               std::this_thread::yield();
+                             }
+                           }
+                         });
+  }
+
+  for (int i {0}; i < numItems; ++i)
+  {
+    aDeque.push(i);
+    if ( 0 == i % 3 )
+    {
+      auto [cbS, item] = aDeque.pop();
+      if ( circular_buffer::cbBase::cbStatus::REMOVED == cbS )
+      {
+        taken[item].fetch_add(1);
+      }
+    }
+  }
+  done.store(true);
+  for (auto& t : thieves)
+  {
+    t.join();
+  }
+
+  for (int i {0}; i < numItems; ++i)
+  {
+    ASSERT_EQ(1, taken[i].load()) << "item " << i;
+  }
+}
+
+TEST(executor, test_1)
+{
+  EXPECT_THROW(circular_buffer::cbExecutor anExecutor(0), std::invalid_argument);
+  EXPECT_THROW(circular_buffer::cbExecutor anExecutor(2, 16, true, {0}), std::invalid_argument);
+}
+
+TEST(executor, test_2)
+{
+  circular_buffer::cbExecutor anExecutor(2, 8);
+
+  ASSERT_EQ(2, anExecutor.getNumWorkers());
+
+  auto f1 {anExecutor.submit([] () { return 6 * 7; })};
+  auto f2 {anExecutor.submit([] () -> std::string { return "done"; })};
+  auto f3 {anExecutor.submit([] () -> int { throw std::runtime_error("failed"); })};
+  int value {0};
+  auto f4 {anExecutor.submit([&value] () { value = 123; })};
+
+  ASSERT_EQ(42, f1.get());
+  ASSERT_EQ("done", f2.get());
+  EXPECT_THROW(f3.get(), std::runtime_error);
+  f4.get();
+  ASSERT_EQ(true, f4.isReady());
+  ASSERT_EQ(123, value);
+}
+
+TEST(executor, test_3)
+{
+  constexpr int numTasks {10'000};
+  std::atomic<int> counter {0};
+
+  // small buffers so that submit() has to wait for room; with and without
+  // work stealing
+  for (bool workStealing : {true, false})
+  {
+    counter.store(0);
+    {
+      circular_buffer::cbExecutor anExecutor(3, 4, workStealing);
+
+      for (int i {0}; i < numTasks; ++i)
+      {
+        anExecutor.post([&counter] () { counter.fetch_add(1); });
+      }
+      // the destructor runs all the pending tasks
+    }
+    ASSERT_EQ(numTasks, counter.load());
+  }
+}
+
+TEST(executor, test_4)
+{
+  // a worker submitting tasks while all the buffers are full runs them inline
+  // instead of waiting forever for room
+  constexpr int numSubtasks {8};
+  std::atomic<int> counter {0};
+
+  {
+    circular_buffer::cbExecutor anExecutor(1, 1);
+    auto f {anExecutor.submit([&anExecutor, &counter] ()
+                              {
+                                for (int i {0}; i < numSubtasks; ++i)
+                                {
+                                  anExecutor.post([&counter] () { counter.fetch_add(1); });
+                                }
+                                return true;
+                              })};
+    ASSERT_EQ(true, f.get());
+  }
+  ASSERT_EQ(numSubtasks, counter.load());
+
+  // futures destroyed as soon as they are ready
+  circular_buffer::cbExecutor anExecutor(2);
+  for (int i {0}; i < 1'000; ++i)
+  {
+    auto f {anExecutor.submit([i] () { return i; })};
+    ASSERT_EQ(i, f.get());
+  }
+}
+
+TEST(executor, test_5)
+{
+  // tasks posted by a running task while the executor is destroyed run too,
+  // also on a worker whose own buffer was already empty
+  constexpr int numSubtasks {8};
+  std::atomic<int> counter {0};
+
+  {
+    circular_buffer::cbExecutor anExecutor(2, 16, false);
+
+    anExecutor.post([&anExecutor, &counter] ()
+                    {
+                      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                      for (int i {0}; i < numSubtasks; ++i)
+                      {
+                        anExecutor.post([&counter] () { counter.fetch_add(1); });
+                      }
+                    });
+  }
+  ASSERT_EQ(numSubtasks, counter.load());
+
+  // a posted task throwing does not terminate the process
+  counter.store(0);
+  {
+    circular_buffer::cbExecutor anExecutor(1);
+
+    anExecutor.post([] () { throw std::runtime_error("failed"); });
+    anExecutor.post([&counter] () { counter.fetch_add(1); });
+  }
+  ASSERT_EQ(1, counter.load());
+}
+
+TEST(timingWheel, test_1)
+{
+  using tw_t = circular_buffer::cbTimingWheel<int>;
+
+  EXPECT_THROW(tw_t aTimingWheel(0), std::invalid_argument);
+  EXPECT_THROW(tw_t aTimingWheel(8, 0, 4), std::invalid_argument);
+  EXPECT_THROW(tw_t aTimingWheel(8, 4, 0), std::invalid_argument);
+}
+
+TEST(timingWheel, test_2)
+{
+  circular_buffer::cbTimingWheel<int> aTimingWheel(2, 8, 4);
+
+  circular_buffer::cbBase::cbStatus cbS {};
+  circular_buffer::cbTimingWheel<int>::timerId id {};
+
+  std::tie(cbS, id) = aTimingWheel.schedule(3, 1);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, cbS);
+  aTimingWheel.schedule(1, 2);
+  std::tie(cbS, id) = aTimingWheel.schedule(5, 3);
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::FULL, cbS);
+  // the id given on FULL never cancels a live timer
+  ASSERT_EQ(false, aTimingWheel.cancel(id));
+  ASSERT_EQ(2, aTimingWheel.getNumTimers());
+
+  std::vector<std::pair<uint64_t, int>> expired {};
+  auto onExpire = [&aTimingWheel, &expired] (int p) { expired.emplace_back(aTimingWheel.now(), p); };
+  for (int t {0}; t < 4; ++t)
+  {
+    aTimingWheel.tick(onExpire);
+  }
+  ASSERT_THAT(expired, ElementsAre(std::make_pair(1, 2), std::make_pair(3, 1)));
+  ASSERT_EQ(true, aTimingWheel.isEmpty());
+}
+
+TEST(timingWheel, test_3)
+{
+  circular_buffer::cbTimingWheel<int> aTimingWheel(4, 8, 4);
+
+  circular_buffer::cbBase::cbStatus cbS {};
+  circular_buffer::cbTimingWheel<int>::timerId id {};
+
+  std::tie(cbS, id) = aTimingWheel.schedule(2, 1);
+  ASSERT_EQ(true, aTimingWheel.cancel(id));
+  // cancelled once only, also when the node is reused
+  ASSERT_EQ(false, aTimingWheel.cancel(id));
+  auto [cbS2, id2] = aTimingWheel.schedule(2, 2);
+  ASSERT_EQ(false, aTimingWheel.cancel(id));
+
+  auto onExpire = [&aTimingWheel, id2] (int p) { if ( 3 == p ) { aTimingWheel.cancel(id2); } };
+  aTimingWheel.schedule(2, 3);
+  ASSERT_EQ(2, aTimingWheel.getNumTimers());
+  // the first expired timer may cancel the second one in the same bucket
+  const size_t numExpired {aTimingWheel.tick(onExpire) + aTimingWheel.tick(onExpire)};
+  ASSERT_EQ(1, numExpired);
+  ASSERT_EQ(true, aTimingWheel.isEmpty());
+}
+
+TEST(timingWheel, test_4)
+{
+  // level 0 covers 8 ticks, level 1 covers 32 ticks: timeouts beyond the level 1
+  // range need more turns of the wheel
+  constexpr uint64_t numTicks {1'000};
+  const std::vector<uint64_t> delays {1, 7, 8, 9, 31, 32, 33, 100, 257, 999};
+  circular_buffer::cbTimingWheel<uint64_t> aTimingWheel(delays.size(), 8, 4);
+
+  // start from a tick not aligned to the levels
+  for (int t {0}; t < 5; ++t)
+  {
+    aTimingWheel.tick([] (uint64_t) {});
+  }
+  const uint64_t start {aTimingWheel.now()};
+  for (auto d : delays)
+  {
+    aTimingWheel.schedule(d, start + d);
+  }
+
+  std::vector<uint64_t> deadlines {};
+  for (uint64_t t {0}; t < numTicks; ++t)
+  {
+    aTimingWheel.tick([&aTimingWheel, &deadlines] (uint64_t deadline)
+                      {
+                        EXPECT_EQ(deadline, aTimingWheel.now());
+                        deadlines.push_back(deadline);
+                      });
+  }
+  ASSERT_EQ(delays.size(), deadlines.size());
+  ASSERT_EQ(true, aTimingWheel.isEmpty());
+}
+
+TEST(slabQueue, test_1)
+{
+  EXPECT_THROW(circular_buffer::cbSlab<int> aSlab(0), std::invalid_argument);
+}
+
+TEST(slabQueue, test_2)
+{
+  circular_buffer::cbSlab<std::array<char, 4'096>> aSlab(2);
+
+  circular_buffer::cbBase::cbStatus cbS {};
+  uint32_t i {};
+  uint32_t j {};
+
+  std::tie(cbS, i) = aSlab.acquire();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::FOUND, cbS);
+  std::tie(cbS, j) = aSlab.acquire();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::FOUND, cbS);
+  ASSERT_NE(i, j);
+  std::tie(cbS, std::ignore) = aSlab.acquire();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::FULL, cbS);
+
+  std::tie(cbS, std::ignore) = aSlab.consume();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::EMPTY, cbS);
+
+  // published in reverse order: consumed in publishing order
+  aSlab[j].fill('j');
+  aSlab[i].fill('i');
+  aSlab.publish(j);
+  aSlab.publish(i);
+  ASSERT_EQ(2, aSlab.getNumReady());
+  ASSERT_EQ(0, aSlab.getNumFree());
+
+  uint32_t k {};
+  std::tie(cbS, k) = aSlab.consume();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::REMOVED, cbS);
+  ASSERT_EQ(j, k);
+  ASSERT_EQ('j', aSlab[k].back());
+  aSlab.release(k);
+  ASSERT_EQ(1, aSlab.getNumFree());
+
+  // the released slot is recycled, content included
+  std::tie(cbS, k) = aSlab.acquire();
+  ASSERT_EQ(j, k);
+  ASSERT_EQ('j', aSlab[k].front());
+}
+
+TEST(slabQueue, test_3)
+{
+  constexpr uint32_t numItems {10'000};
+  circular_buffer::cbSlab<std::array<uint32_t, 256>> aSlab(8);
+
+  std::thread producer([&aSlab] ()
+                       {
+                         for (uint32_t n {0}; n < numItems; )
+                         {
+                           auto [cbS, i] = aSlab.acquire();
+                           if ( circular_buffer::cbBase::cbStatus::FOUND != cbS )
+                           {
+                             std::this_thread::yield();
+                             continue;
+                           }
+                           aSlab[i].fill(n++);
+                           aSlab.publish(i);
+                         }
+                       });
+
+  uint32_t expected {0};
+  while ( expected < numItems )
+  {
+    auto [cbS, i] = aSlab.consume();
+    if ( circular_buffer::cbBase::cbStatus::REMOVED != cbS )
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(expected, aSlab[i].front());
+    ASSERT_EQ(expected, aSlab[i].back());
+    ++expected;
+    aSlab.release(i);
+  }
+  producer.join();
+  ASSERT_EQ(aSlab.size(), aSlab.getNumFree());
+}
+
+// market data style update: the key is the instrument
+struct quote
+{
+  uint32_t m_instrument {0};
+  uint64_t m_price {0};
+};
+
+struct quoteInstrument
+{
+  uint32_t
+  operator()(const quote& q) const noexcept
+  {
+    return q.m_instrument;
+  }
+};
+
+using conflating_t = circular_buffer::cbConflating<quote, quoteInstrument>;
+
+TEST(conflatingBuffer, test_1)
+{
+  conflating_t aConflatingBuffer(2);
+
+  circular_buffer::cbBase::cbStatus cbS {};
+  size_t numElements {};
+  quote q {};
+
+  std::tie(cbS, numElements) = aConflatingBuffer.add({1, 100});
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, cbS);
+  aConflatingBuffer.add({2, 200});
+  // full, but the key is pending: conflated
+  std::tie(cbS, numElements) = aConflatingBuffer.add({1, 101});
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::CONFLATED, cbS);
+  ASSERT_EQ(2, numElements);
+  ASSERT_EQ("CONFLATED", aConflatingBuffer.cbStatusString(cbS));
+  std::tie(cbS, numElements) = aConflatingBuffer.add({3, 300});
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::FULL, cbS);
+  aConflatingBuffer.add({1, 102});
+  ASSERT_EQ(2, aConflatingBuffer.getNumConflated());
+
+  // order of first arrival, latest value
+  std::tie(cbS, q, numElements) = aConflatingBuffer.remove();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::REMOVED, cbS);
+  ASSERT_EQ(1, q.m_instrument);
+  ASSERT_EQ(102, q.m_price);
+  ASSERT_EQ(1, numElements);
+
+  // a removed key is not pending anymore: added again at the back
+  std::tie(cbS, numElements) = aConflatingBuffer.add({1, 103});
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, cbS);
+  std::tie(cbS, q, numElements) = aConflatingBuffer.remove();
+  ASSERT_EQ(2, q.m_instrument);
+  std::tie(cbS, q, numElements) = aConflatingBuffer.remove();
+  ASSERT_EQ(1, q.m_instrument);
+  ASSERT_EQ(103, q.m_price);
+  std::tie(cbS, q, numElements) = aConflatingBuffer.remove();
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::EMPTY, cbS);
+}
+
+TEST(conflatingBuffer, test_2)
+{
+  // random adds and removes checked against a simple model: colliding keys
+  // exercise the backward-shift deletion of the index
+  constexpr unsigned long cbsize {16};
+  conflating_t aConflatingBuffer(cbsize);
+  std::deque<quote> model {};
+  std::mt19937 generator {7};
+  std::uniform_int_distribution<uint32_t> instruments {0, 40};
+  std::bernoulli_distribution doAdd {0.6};
+
+  for (uint64_t n {0}; n < 100'000; ++n)
+  {
+    if ( doAdd(generator) )
+    {
+      const quote q {instruments(generator) * 32, n};
+      auto it {std::find_if(model.begin(), model.end(),
+                            [&q] (const quote& m) { return m.m_instrument == q.m_instrument; })};
+      auto [cbS, numElements] = aConflatingBuffer.add(q);
+
+      if ( model.end() != it )
+      {
+        ASSERT_EQ(circular_buffer::cbBase::cbStatus::CONFLATED, cbS);
+        it->m_price = q.m_price;
+      }
+      else if ( model.size() == cbsize )
+      {
+        ASSERT_EQ(circular_buffer::cbBase::cbStatus::FULL, cbS);
+      }
+      else
+      {
+        ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, cbS);
+        model.push_back(q);
+      }
+    }
+    else
+    {
+      auto [cbS, q, numElements] = aConflatingBuffer.remove();
+
+      if ( model.empty() )
+      {
+        ASSERT_EQ(circular_buffer::cbBase::cbStatus::EMPTY, cbS);
+        continue;
+      }
+      ASSERT_EQ(circular_buffer::cbBase::cbStatus::REMOVED, cbS);
+      ASSERT_EQ(model.front().m_instrument, q.m_instrument);
+      ASSERT_EQ(model.front().m_price, q.m_price);
+      model.pop_front();
+    }
+    ASSERT_EQ(model.size(), aConflatingBuffer.getNumElements());
+  }
+}
+
+TEST(watermarks, test_1)
+{
+  const cb_t aCircularBuffer(4);
+
+  EXPECT_THROW(aCircularBuffer.setWatermarks(0, 0), std::invalid_argument);
+  EXPECT_THROW(aCircularBuffer.setWatermarks(5, 1), std::invalid_argument);
+  EXPECT_THROW(aCircularBuffer.setWatermarks(2, 2), std::invalid_argument);
+  EXPECT_NO_THROW(aCircularBuffer.setWatermarks(4, 0));
+}
+
+TEST(watermarks, test_2)
+{
+  using watermark_t = circular_buffer::cbBase::cbWatermark;
+
+  const cb_t aCircularBuffer(8);
+  std::vector<std::pair<watermark_t, unsigned long>> crossings {};
+
+  aCircularBuffer.setWatermarks(6, 2,
+                                [&crossings] (watermark_t w, unsigned long n) { crossings.emplace_back(w, n); });
+  for (cbtype i {0}; i < 8; ++i)
+  {
+    aCircularBuffer.add(i);
+  }
+  ASSERT_EQ(true, aCircularBuffer.isAboveHighWatermark());
+  // FULL does not notify again
+  aCircularBuffer.add(8);
+
+  // hysteresis: still above until the low watermark is reached
+  for (int i {0}; i < 5; ++i)
+  {
+    aCircularBuffer.remove();
+  }
+  ASSERT_EQ(true, aCircularBuffer.isAboveHighWatermark());
+  ASSERT_EQ(1, crossings.size());
+  aCircularBuffer.remove();
+  ASSERT_EQ(false, aCircularBuffer.isAboveHighWatermark());
+
+  // going up and down between the watermarks does not notify
+  for (int i {0}; i < 3; ++i)
+  {
+    aCircularBuffer.add(0);
+    aCircularBuffer.remove();
+  }
+  aCircularBuffer.add(0);
+  aCircularBuffer.add(0);
+  aCircularBuffer.add(0);
+  aCircularBuffer.add(0);
+
+  ASSERT_THAT(crossings, ElementsAre(std::make_pair(watermark_t::HIGH, 6),
+                                     std::make_pair(watermark_t::LOW, 2),
+                                     std::make_pair(watermark_t::HIGH, 6)));
+}
+
+TEST(watermarks, test_3)
+{
+  // same notifications from the other buffers derived from cbBase, and with
+  // the flag only
+  circular_buffer::cbColumnar<int, double> aColumnarBuffer(4);
+  conflating_t aConflatingBuffer(4);
+
+  aColumnarBuffer.setWatermarks(3, 1);
+  aConflatingBuffer.setWatermarks(3, 1);
+  for (int i {0}; i < 3; ++i)
+  {
+    aColumnarBuffer.add(i, 0.0);
+    aConflatingBuffer.add({static_cast<uint32_t>(i), 0});
+  }
+  ASSERT_EQ(true, aColumnarBuffer.isAboveHighWatermark());
+  ASSERT_EQ(true, aConflatingBuffer.isAboveHighWatermark());
+  aColumnarBuffer.remove();
+  aConflatingBuffer.remove();
+  ASSERT_EQ(true, aColumnarBuffer.isAboveHighWatermark());
+  aColumnarBuffer.remove();
+  aConflatingBuffer.remove();
+  ASSERT_EQ(false, aColumnarBuffer.isAboveHighWatermark());
+  ASSERT_EQ(false, aConflatingBuffer.isAboveHighWatermark());
+}
+
+TEST(watermarks, test_4)
+{
+  // late HIGH: the consumer drains the buffer while the producer is still
+  // notifying the crossing of the high watermark; the flag must end up
+  // agreeing with the empty buffer and a LOW notification must follow
+  using watermark_t = circular_buffer::cbBase::cbWatermark;
+
+  const cb_t aCircularBuffer(8);
+  std::vector<watermark_t> crossings {};
+  std::atomic<int> phase {0};
+
+  aCircularBuffer.setWatermarks(4, 1,
+                                [&crossings, &phase] (watermark_t w, unsigned long)
+                                {
+                                  crossings.push_back(w);
+                                  if ( watermark_t::HIGH == w )
+                                  {
+                                    phase.store(1);
+                                    while ( 1 == phase.load() ) { std::this_thread::yield(); }
+                                  }
+                                });
+
+  std::thread producer([&aCircularBuffer] ()
+                       {
+                         for (cbtype i {0}; i < 4; ++i)
+                         {
+                           aCircularBuffer.add(i);
+                         }
+                       });
+  while ( 0 == phase.load() ) { std::this_thread::yield(); }
+  while ( circular_buffer::cbBase::cbStatus::REMOVED == std::get<0>(aCircularBuffer.remove()) ) {}
+  ASSERT_EQ(false, aCircularBuffer.isAboveHighWatermark());
+  phase.store(2);
+  producer.join();
+
+  ASSERT_EQ(true, aCircularBuffer.isEmpty());
+  ASSERT_EQ(false, aCircularBuffer.isAboveHighWatermark());
+  ASSERT_THAT(crossings, ElementsAre(watermark_t::HIGH, watermark_t::LOW));
+}
+
+TEST(watermarks, test_5)
+{
+  // concurrent producers and consumer: notifications alternate and the last
+  // one agrees with the flag, which agrees with the number of elements
+  using watermark_t = circular_buffer::cbBase::cbWatermark;
+
+  constexpr cbtype numItems {20'000};
+  const cb_t aCircularBuffer(16);
+  std::vector<watermark_t> crossings {};
+
+  aCircularBuffer.setWatermarks(12, 4,
+                                [&crossings] (watermark_t w, unsigned long) { crossings.push_back(w); });
+
+  std::vector<std::thread> producers {};
+  for (int p {0}; p < 2; ++p)
+  {
+    producers.emplace_back([&aCircularBuffer] ()
+                           {
+                             for (cbtype i {0}; i < numItems; )
+                             {
+                               if ( circular_buffer::cbBase::cbStatus::ADDED == std::get<0>(aCircularBuffer.add(i)) )
+                               {
+                                 ++i;
+                               }
+                               else
+                               {
+                                 std::this_thread::yield();
+                               }
+                             }
+                           });
+  }
+  for (int removed {0}; removed < 2 * numItems - 8; )
+  {
+    if ( circular_buffer::cbBase::cbStatus::REMOVED == std::get<0>(aCircularBuffer.remove()) )
+    {
+      ++removed;
+    }
+    else
+    {
+      std::this_thread::yield();
+    }
+  }
+  for (auto& p : producers)
+  {
+    p.join();
+  }
+
+  ASSERT_EQ(8, aCircularBuffer.getNumElements());
+  for (size_t i {0}; i < crossings.size(); ++i)
+  {
+    ASSERT_EQ((0 == i % 2) ? watermark_t::HIGH : watermark_t::LOW, crossings[i]);
+  }
+  // 8 elements: between the watermarks, the flag keeps the last crossing
+  ASSERT_EQ(aCircularBuffer.isAboveHighWatermark(),
+            !crossings.empty() && (watermark_t::HIGH == crossings.back()));
+  // down to the low watermark
+  for (int i {0}; i < 4; ++i)
+  {
+    aCircularBuffer.remove();
+  }
+  ASSERT_EQ(false, aCircularBuffer.isAboveHighWatermark());
+  ASSERT_EQ(true, crossings.empty() || (watermark_t::LOW == crossings.back()));
+}
+
+TEST(binaryLogger, test_1)
+{
+  const uint32_t format {circular_buffer::cbLogger::registerFormat("no logger {}\n")};
+
+  // no logger: nothing logged
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::UNKNOWN, circular_buffer::cbLogger::log(format, 1));
+
+  std::ostringstream os {};
+  EXPECT_THROW(circular_buffer::cbLogger aLogger(os, 0), std::invalid_argument);
+
+  const circular_buffer::cbLogger aLogger(os);
+  EXPECT_THROW(circular_buffer::cbLogger anotherLogger(os), std::invalid_argument);
+}
+
+TEST(binaryLogger, test_2)
+{
+  const uint32_t format {circular_buffer::cbLogger::registerFormat("[{}] {} {} {} {} {}|{}\n")};
+  std::ostringstream os {};
+
+  {
+    const circular_buffer::cbLogger aLogger(os);
+    const std::string status {"ADDED"};
+
+    ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED,
+              circular_buffer::cbLogger::log(format, "test", -42, uint64_t {42}, 0.5, true, 'x'));
+    // missing arguments are left out
+    circular_buffer::cbLogger::log(format, status.c_str(), 1);
+    circular_buffer::cbLogger::flush();
+    ASSERT_EQ("[test] -42 42 0.5 true x|\n[ADDED] 1    |\n", os.str());
+  }
+  // the logger is gone
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::UNKNOWN, circular_buffer::cbLogger::log(format));
+}
+
+TEST(binaryLogger, test_3)
+{
+  // records of all the threads are written in timestamp order; a thread
+  // logging faster than the logger drains drops records
+  constexpr int numThreads {4};
+  constexpr int numRecords {1'000};
+  const uint32_t format {circular_buffer::cbLogger::registerFormat("{} {}\n")};
+  std::ostringstream os {};
+
+  {
+    const circular_buffer::cbLogger aLogger(os, 4'096, std::chrono::microseconds(100));
+    std::vector<std::thread> threads {};
+
+    for (int t {0}; t < numThreads; ++t)
+    {
+      threads.emplace_back([t, format] ()
+                           {
+                             for (int i {0}; i < numRecords; ++i)
+                             {
+                               circular_buffer::cbLogger::log(format, t, i);
+                             }
+                           });
+    }
+    for (auto& thrd : threads)
+    {
+      thrd.join();
+    }
+    ASSERT_EQ(0, circular_buffer::cbLogger::getNumDropped());
+  }
+
+  std::istringstream is {os.str()};
+  std::vector<int> next(numThreads, 0);
+  int t {};
+  int i {};
+  while ( is >> t >> i )
+  {
+    ASSERT_EQ(next[t], i);
+    ++next[t];
+  }
+  ASSERT_THAT(next, Each(numRecords));
+
+  std::ostringstream os2 {};
+  const circular_buffer::cbLogger aLogger(os2, 2, std::chrono::microseconds(1'000'000));
+  circular_buffer::cbBase::cbStatus cbS {circular_buffer::cbBase::cbStatus::ADDED};
+  for (int n {0}; (n < 1'000) && (circular_buffer::cbBase::cbStatus::ADDED == cbS); ++n)
+  {
+    cbS = circular_buffer::cbLogger::log(format, 0, n);
+  }
+  ASSERT_EQ(circular_buffer::cbBase::cbStatus::FULL, cbS);
+  ASSERT_EQ(1, circular_buffer::cbLogger::getNumDropped());
+}
+
+TEST(binaryLogger, test_4)
+{
+  // a thread logging through two loggers in sequence writes to the second one
+  const uint32_t format {circular_buffer::cbLogger::registerFormat("logger {}\n")};
+  std::ostringstream os1 {};
+  std::ostringstream os2 {};
+
+  {
+    const circular_buffer::cbLogger aLogger(os1);
+
+    ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, circular_buffer::cbLogger::log(format, 1));
+  }
+  ASSERT_EQ("logger 1\n", os1.str());
+
+  {
+    const circular_buffer::cbLogger aLogger(os2);
+
+    ASSERT_EQ(circular_buffer::cbBase::cbStatus::ADDED, circular_buffer::cbLogger::log(format, 2));
+    circular_buffer::cbLogger::flush();
+    ASSERT_EQ("logger 2\n", os2.str());
+  }
+  ASSERT_EQ("logger 1\n", os1.str());
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,220 @@
+/*
+ * File:   workStealingDeque.h
+ */
+#pragma once
+
+#include "circularBuffer.h"
+#include <atomic>
+#include <bit>
+#include <type_traits>
+#include <vector>
+////////////////////////////////////////////////////////////////////////////////
+namespace circular_buffer
+{
+// Growable Chase-Lev work-stealing deque, with the memory orderings of
+// "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al.).
+// The owner thread pushes and pops items at the bottom; any other thread steals
+// items from the top.
+// Items are stored in a circular buffer indexed by the monotonic top and bottom
+// counters; when it is full the owner replaces it with one of twice the size.
+// Replaced buffers may still be read by thieves: they are kept until the deque
+// is destroyed
+template <typename T>
+class cbDeque final
+{
+  static_assert(std::is_trivially_copyable<T>::value, "expected trivially copyable types");
+
+  using cbaddret = std::tuple<cbBase::cbStatus, size_t>;
+  using cbremret = std::tuple<cbBase::cbStatus, T>;
+
+  constexpr static inline T m_noItem {};
+
+  class ring final
+  {
+    const int64_t m_size {};
+    const int64_t m_mask {};
+    std::unique_ptr<std::atomic<T>[]> m_pData {};
+
+   public:
+    // size must be a power of 2
+    explicit
+    ring(const int64_t size)
+    :
+    m_size(size),
+    m_mask(size - 1),
+    m_pData (std::make_unique<std::atomic<T>[]>(static_cast<size_t>(size)))
+    {}
+
+    constexpr
+    int64_t
+    size() const noexcept
+    {
+      return m_size;
+    }
+
+    T
+    get(const int64_t i) const noexcept
+    {
+      return m_pData.get()[i & m_mask].load(std::memory_order_relaxed);
+    }
+
+    void
+    put(const int64_t i, const T& item) const noexcept
+    {
+      m_pData.get()[i & m_mask].store(item, std::memory_order_relaxed);
+    }
+  };  // class ring
+
+  // top and bottom on their own cache lines: top is written by the thieves,
+  // bottom by the owner
+  alignas(64) std::atomic<int64_t> m_top {0};
+  alignas(64) std::atomic<int64_t> m_bottom {0};
+  alignas(64) std::atomic<ring*> m_pRing {nullptr};
+  // all the rings ever allocated; accessed by the owner only
+  std::vector<std::unique_ptr<ring>> m_rings {};
+
+  ring*
+  _grow(const ring* pRing, const int64_t top, const int64_t bottom)
+  {
+    m_rings.push_back(std::make_unique<ring>(2 * pRing->size()));
+    ring* pNewRing {m_rings.back().get()};
+
+    for (int64_t i {top}; i < bottom; ++i)
+    {
+      pNewRing->put(i, pRing->get(i));
+    }
+    m_pRing.store(pNewRing, std::memory_order_release);
+
+    return pNewRing;
+  }
+
+ public:
+  // we don't want these objects allocated on the heap
+  void* operator new(std::size_t) = delete;
+  void* operator new[](std::size_t) = delete;
+
+  void operator delete(void*) = delete;
+  void operator delete[](void*) = delete;
+
+  cbDeque(const cbDeque&) = delete;
+  cbDeque& operator= (const cbDeque&) = delete;
+  cbDeque(const cbDeque&&) = delete;
+  cbDeque& operator= (const cbDeque&&) = delete;
+
+  // the initial size is rounded up to a power of 2
+  explicit
+  cbDeque(const size_t initialSize = 64) noexcept(false)
+  {
+    if ( 0 == initialSize )
+    {
+      throw std::invalid_argument("ERROR: The size of the deque must not be zero");
+    }
+    m_rings.push_back(std::make_unique<ring>(static_cast<int64_t>(std::bit_ceil(initialSize))));
+    m_pRing.store(m_rings.back().get(), std::memory_order_relaxed);
+  }
+
+  // owner only: add an item at the bottom; the deque grows when full.
+  // Return the status and the number of items after the action
+  cbaddret
+  push(const T& item) noexcept(false)
+  {
+    const int64_t b {m_bottom.load(std::memory_order_relaxed)};
+    const int64_t t {m_top.load(std::memory_order_acquire)};
+    ring* pRing {m_pRing.load(std::memory_order_relaxed)};
+
+    if ( b - t > pRing->size() - 1 )
+    {
+      pRing = _grow(pRing, t, b);
+    }
+    pRing->put(b, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(b + 1, std::memory_order_relaxed);
+
+    return std::make_tuple(cbBase::cbStatus::ADDED, static_cast<size_t>(b + 1 - t));
+  }
+
+  // owner only: remove the item at the bottom, if not empty
+  cbremret
+  pop() noexcept
+  {
+    const int64_t b {m_bottom.load(std::memory_order_relaxed) - 1};
+    const ring* pRing {m_pRing.load(std::memory_order_relaxed)};
+
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t {m_top.load(std::memory_order_relaxed)};
+
+    if ( t > b )
+    {
+      // empty
+      m_bottom.store(b + 1, std::memory_order_relaxed);
+      return std::make_tuple(cbBase::cbStatus::EMPTY, m_noItem);
+    }
+
+    const T item {pRing->get(b)};
+    if ( t == b )
+    {
+      // last item: race against the thieves for it
+      const bool won {m_top.compare_exchange_strong(t, t + 1,
+                                                    std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed)};
+      m_bottom.store(b + 1, std::memory_order_relaxed);
+      if ( !won )
+      {
+        return std::make_tuple(cbBase::cbStatus::EMPTY, m_noItem);
+      }
+    }
+    return std::make_tuple(cbBase::cbStatus::REMOVED, item);
+  }
+
+  // any thread: remove the item at the top, if not empty; a lost race with
+  // another thief or the owner is retried
+  cbremret
+  steal() noexcept
+  {
+    while ( true )
+    {
+      int64_t t {m_top.load(std::memory_order_acquire)};
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const int64_t b {m_bottom.load(std::memory_order_acquire)};
+
+      if ( t >= b )
+      {
+        return std::make_tuple(cbBase::cbStatus::EMPTY, m_noItem);
+      }
+
+      const ring* pRing {m_pRing.load(std::memory_order_acquire)};
+      const T item {pRing->get(t)};
+      if ( m_top.compare_exchange_strong(t, t + 1,
+                                         std::memory_order_seq_cst,
+                                         std::memory_order_relaxed) )
+      {
+        return std::make_tuple(cbBase::cbStatus::REMOVED, item);
+      }
+    }
+  }
+
+  // approximate number of items when other threads are working on the deque
+  size_t
+  getNumElements() const noexcept
+  {
+    const int64_t b {m_bottom.load(std::memory_order_relaxed)};
+    const int64_t t {m_top.load(std::memory_order_relaxed)};
+
+    return (b > t) ? static_cast<size_t>(b - t) : 0;
+  }
+
+  bool
+  isEmpty() const noexcept
+  {
+    return (0 == getNumElements());
+  }
+
+  // current capacity; changes only in the owner thread
+  size_t
+  size() const noexcept
+  {
+    return static_cast<size_t>(m_pRing.load(std::memory_order_relaxed)->size());
+  }
+};  // class cbDeque
+}  // namespace circular_buffer